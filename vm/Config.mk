@@ -91,11 +91,32 @@
 # go breaking it, which we promise you will happen.
 
          SHADOWD=0 # shadow page cleanup
-        MOUNTING=0 # be able to mount multiple file systems
+        MOUNTING=1 # be able to mount multiple file systems
           GETCWD=0 # getcwd(3) syscall-like functionality
         UPREEMPT=0 # userland preemption
              MTP=0 # multiple kernel threads per process
-           PIPES=0 # pipe(2) functionality
+           PIPES=1 # pipe(2) functionality
+
+# Compile in the "(GRADING...)" dbg() messages. They are printed with
+# DBG_PRINT, so they only show up when DBG includes "print"; when it does
+# not, set this to 0 to remove them from the kernel altogether rather than
+# filtering them at runtime.
+   GRADING_TRACE=1
+
+# Put a pattern-filled guard page below every kernel stack and check it
+# for overflow whenever a thread's stack is freed.
+    KSTACK_GUARD=0
+
+# How many unreferenced vnodes to keep cached after their last close, so
+# that re-opening a recently used file does not have to read it in from
+# the file system again. 0 disables the cache.
+       VNODE_LRU=128
+
+# Start the kernel shell on the first terminal before running /sbin/init,
+# for the statistics and benchmark commands built into the kernel
+# (schedstat, sysstat, trace, dcache, namevbench, pipebench, rwbench).
+# Leaving the shell with "exit" carries on booting into /sbin/init.
+          KSHELL=0
 
 # Set the number of terminals that we should be launching.
         NTERMS=3
@@ -119,6 +140,6 @@
 
 # Boolean options specified in this specified in this file that should be
 # included as definitions at compile time
-        COMPILE_CONFIG_BOOLS=" DRIVERS VFS S5FS VM FI DYNAMIC MOUNTING MTP SHADOWD GETCWD UPREEMPT PIPES "
+        COMPILE_CONFIG_BOOLS=" DRIVERS VFS S5FS VM FI DYNAMIC MOUNTING MTP SHADOWD GETCWD UPREEMPT PIPES KSTACK_GUARD GRADING_TRACE KSHELL "
 # As above, but not booleans
-        COMPILE_CONFIG_DEFS=" NTERMS NDISKS DBG DISK_SIZE "
+        COMPILE_CONFIG_DEFS=" NTERMS NDISKS DBG DISK_SIZE VNODE_LRU "
@@ -21,37 +21,105 @@
 
 #include "util/string.h"
 #include "util/debug.h"
+#include "util/trace.h"
 
 #include "mm/mman.h"
 #include "mm/page.h"
 #include "mm/mm.h"
 #include "mm/kmalloc.h"
+#include "mm/pframe.h"
+#include "mm/pagetable.h"
+#include "mm/tlb.h"
 
 #include "proc/proc.h"
 
 #include "vm/vmmap.h"
+#include "vm/vmmap_lock.h"
 
 #include "api/access.h"
 #include "api/syscall.h"
+#include "api/user_page.h"
 
-/* copy_to_user and copy_from_user are used to copy to and from the
- * user space of the current process.  They first check that the range
- * of addresses has valid mappings, then call vmmap_read/write.
+/*
+ * Moves nbytes between kaddr and the user range starting at uaddr in
+ * curproc, checking permissions as it goes. Syscall arguments almost
+ * always live in pages the process has just touched, so each page is
+ * first looked for among the resident pages of its vmarea's top object.
+ * Such a page is what the process sees at that address and can be copied
+ * straight away. Writing to it needs no further bookkeeping if it is
+ * pinned (anonymous memory never gets cleaned) or already dirty. Only
+ * other pages take the slow path through user_page_get, which walks the
+ * shadow chain and may block. The vmarea is looked up once per area
+ * rather than once per page.
  */
-int copy_from_user(void *kaddr, const void *uaddr, size_t nbytes)
+static int
+user_copy(void *uaddr, void *kaddr, size_t nbytes, int towrite)
 {
-        if (!range_perm(curproc, uaddr, nbytes, PROT_READ)) {
+        vmmap_t *map = curproc->p_vmmap;
+        uint32_t addr = (uint32_t)uaddr;
+        vmarea_t *vma = NULL;
+        size_t done = 0;
+        pframe_t *pf;
+        int err;
+
+        if (addr + nbytes < addr)
                 return -EFAULT;
+
+        vmmap_rdlock(map);
+        while (done < nbytes) {
+                uint32_t pn = ADDR_TO_PN(addr);
+                size_t len = MIN(PAGE_SIZE - PAGE_OFFSET(addr), nbytes - done);
+                char *ubuf;
+
+                if (NULL == vma || pn < vma->vma_start || pn >= vma->vma_end) {
+                        vma = vmmap_lookup(map, pn);
+                        if (NULL == vma || !(vma->vma_prot & (towrite ? PROT_WRITE : PROT_READ))) {
+                                vmmap_rdunlock(map);
+                                return -EFAULT;
+                        }
+                }
+
+                pf = pframe_get_resident(vma->vma_obj, pn - vma->vma_start + vma->vma_off);
+                if (NULL != pf && !pframe_is_busy(pf)
+                    && (!towrite || pframe_is_pinned(pf) || pframe_is_dirty(pf))) {
+                        ubuf = (char *)pf->pf_addr + PAGE_OFFSET(addr);
+                        if (towrite)
+                                memcpy(ubuf, (char *)kaddr + done, len);
+                        else
+                                memcpy((char *)kaddr + done, ubuf, len);
+                } else {
+                        vmmap_rdunlock(map);
+                        if ((err = user_page_get((void *)addr, towrite, &pf)) < 0)
+                                return err;
+                        ubuf = (char *)pf->pf_addr + PAGE_OFFSET(addr);
+                        if (towrite)
+                                memcpy(ubuf, (char *)kaddr + done, len);
+                        else
+                                memcpy((char *)kaddr + done, ubuf, len);
+                        user_page_put(pf);
+                        /* the map may have changed while we slept */
+                        vmmap_rdlock(map);
+                        vma = NULL;
+                }
+                done += len;
+                addr += len;
         }
-        return vmmap_read(curproc->p_vmmap, uaddr, kaddr, nbytes);
+        vmmap_rdunlock(map);
+        return 0;
+}
+
+/* copy_to_user and copy_from_user are used to copy to and from the
+ * user space of the current process. They fail with -EFAULT if any
+ * page of the range is unmapped or lacks the needed permission.
+ */
+int copy_from_user(void *kaddr, const void *uaddr, size_t nbytes)
+{
+        return user_copy((void *)uaddr, kaddr, nbytes, 0);
 }
 
 int copy_to_user(void *uaddr, const void *kaddr, size_t nbytes)
 {
-        if (!range_perm(curproc, uaddr, nbytes, PROT_WRITE)) {
-                return -EFAULT;
-        }
-        return vmmap_write(curproc->p_vmmap, uaddr, kaddr, nbytes);
+        return user_copy(uaddr, (void *)kaddr, nbytes, 1);
 }
 
 /* Like strndup(), but gets the string from user space, ensuring
@@ -138,21 +206,30 @@ fail:
  * function should return 1 on success, and 0 on failure (think of it as
  * anwering the question "does process p have permission perm on address vaddr?")
  */
-int
-addr_perm(struct proc *p, const void *vaddr, int perm)
+static int
+addr_perm_locked(struct proc *p, const void *vaddr, int perm)
 {
         vmarea_t *vma = vmmap_lookup(p->p_vmmap, ADDR_TO_PN(vaddr));
         if (NULL == vma ||
             ((perm & PROT_READ) && !(vma->vma_prot & PROT_READ)) ||
             ((perm & PROT_WRITE) && !(vma->vma_prot & PROT_WRITE)) ||
             ((perm & PROT_EXEC) && !(vma->vma_prot & PROT_EXEC))) {
-		dbg(DBG_PRINT, "(GRADING3D 1)\n");
+		grading_dbg("(GRADING3D 1)\n");
                 return 0;
         }
-	dbg(DBG_PRINT, "(GRADING3A)\n");
+	grading_dbg("(GRADING3A)\n");
         return 1;
 }
 
+int
+addr_perm(struct proc *p, const void *vaddr, int perm)
+{
+        vmmap_rdlock(p->p_vmmap);
+        int ret = addr_perm_locked(p, vaddr, perm);
+        vmmap_rdunlock(p->p_vmmap);
+        return ret;
+}
+
 /*
  * range_perm is essentially a version of addr_perm that checks an entire
  * range of addresses (from avaddr to avaddr+len).  Though you will
@@ -167,14 +244,53 @@ range_perm(struct proc *p, const void *avaddr, size_t len, int perm)
 {
         uint32_t addr = (uint32_t)avaddr;
         uint32_t end = addr + len;
+        vmmap_rdlock(p->p_vmmap);
         while (addr < end) {
-                if (0 == addr_perm(p, (const void *)addr, perm)) {
-                        dbg(DBG_PRINT, "(GRADING3D 1)\n");
+                if (0 == addr_perm_locked(p, (const void *)addr, perm)) {
+                        vmmap_rdunlock(p->p_vmmap);
+                        grading_dbg("(GRADING3D 1)\n");
                         return 0;
                 }
                 addr += PAGE_SIZE;
-                dbg(DBG_PRINT, "(GRADING3A)\n");
+                grading_dbg("(GRADING3A)\n");
         }
-        dbg(DBG_PRINT, "(GRADING3A)\n");
+        vmmap_rdunlock(p->p_vmmap);
+        grading_dbg("(GRADING3A)\n");
         return 1;
 }
+
+int
+user_page_get(const void *uaddr, int forwrite, pframe_t **result)
+{
+        vmmap_t *map = curproc->p_vmmap;
+        uint32_t pn = ADDR_TO_PN(uaddr);
+        vmarea_t *vma;
+        int err;
+
+        vmmap_rdlock(map);
+        if (!addr_perm_locked(curproc, uaddr, forwrite ? PROT_WRITE : PROT_READ)) {
+                vmmap_rdunlock(map);
+                return -EFAULT;
+        }
+        vma = vmmap_lookup(map, pn);
+        err = pframe_lookup(vma->vma_obj, pn - vma->vma_start + vma->vma_off,
+                            forwrite, result);
+        if (0 == err) {
+                pframe_pin(*result);
+                if (forwrite) {
+                        pframe_dirty(*result);
+                        /* a write may have given us a private copy of the
+                         * page; drop any mapping of the old one */
+                        pt_unmap(curproc->p_pagedir, (uintptr_t)PN_TO_ADDR(pn));
+                        tlb_flush((uintptr_t)PN_TO_ADDR(pn));
+                }
+        }
+        vmmap_rdunlock(map);
+        return err;
+}
+
+void
+user_page_put(pframe_t *pf)
+{
+        pframe_unpin(pf);
+}
@@ -0,0 +1,220 @@
+/******************************************************************************/
+/* Important Spring 2020 CSCI 402 usage information:                          */
+/*                                                                            */
+/* This fils is part of CSCI 402 kernel programming assignments at USC.       */
+/*         53616c7465645f5fd1e93dbf35cbffa3aef28f8c01d8cf2ffc51ef62b26a       */
+/*         f9bda5a68e5ed8c972b17bab0f42e24b19daa7bd408305b1f7bd6c7208c1       */
+/*         0e36230e913039b3046dd5fd0ba706a624d33dbaa4d6aab02c82fe09f561       */
+/*         01b0fd977b0051f0b0ce0c69f7db857b1b5e007be2db6d42894bf93de848       */
+/*         806d9152bd5715e9                                                   */
+/* Please understand that you are NOT permitted to distribute or publically   */
+/*         display a copy of this file (or ANY PART of it) for any reason.    */
+/* If anyone (including your prospective employer) asks you to post the code, */
+/*         you must inform them that you do NOT have permissions to do so.    */
+/* You are also NOT permitted to remove or alter this comment block.          */
+/* If this comment block is removed or altered in a submitted file, 20 points */
+/*         will be deducted.                                                  */
+/******************************************************************************/
+
+#include "kernel.h"
+#include "globals.h"
+#include "types.h"
+#include "errno.h"
+
+#include "util/debug.h"
+#include "util/string.h"
+
+#include "mm/mm.h"
+#include "mm/mman.h"
+#include "mm/page.h"
+#include "mm/kmalloc.h"
+
+#include "fs/vfs_syscall.h"
+#include "fs/stat.h"
+
+#include "vm/mmap.h"
+
+#include "api/access.h"
+#include "api/user_page.h"
+#include "api/ring.h"
+
+/* Entries copied in from (or out to) a ring at a time */
+#define RING_BATCH      32
+
+/* Offset of the submission array: the header rounded up to a whole entry */
+#define RING_SQ_OFF     ((sizeof(ring_hdr_t) + sizeof(ring_sqe_t) - 1) & ~(sizeof(ring_sqe_t) - 1))
+
+#define RING_VALID_SIZE(n)      (0 < (n) && (n) <= RING_MAX_ENTRIES && 0 == ((n) & ((n) - 1)))
+
+int
+do_ring_setup(uint32_t entries, void **ret)
+{
+        ring_hdr_t hdr;
+        size_t len;
+        void *addr;
+        int err;
+
+        if (!RING_VALID_SIZE(entries))
+                return -EINVAL;
+
+        memset(&hdr, 0, sizeof(hdr));
+        hdr.rh_magic = RING_MAGIC;
+        hdr.rh_sq_entries = entries;
+        hdr.rh_cq_entries = 2 * entries;
+        hdr.rh_sq_off = RING_SQ_OFF;
+        hdr.rh_cq_off = hdr.rh_sq_off + entries * sizeof(ring_sqe_t);
+        len = (size_t)PAGE_ALIGN_UP(hdr.rh_cq_off + hdr.rh_cq_entries * sizeof(ring_cqe_t));
+
+        if ((err = do_mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANON,
+                           -1, 0, &addr)) < 0)
+                return err;
+        if ((err = copy_to_user(addr, &hdr, sizeof(hdr))) < 0) {
+                do_munmap(addr, len);
+                return err;
+        }
+        *ret = addr;
+        return 0;
+}
+
+/* Copies n entries of size bytes between buf and the user array at
+ * uarr, starting at free-running index pos of a ring of the given size,
+ * in at most two pieces */
+static int
+ring_copy(char *uarr, size_t size, uint32_t entries, uint32_t pos,
+          void *buf, uint32_t n, int out)
+{
+        uint32_t first = pos & (entries - 1);
+        uint32_t k = MIN(n, entries - first);
+        int err;
+
+        err = out ? copy_to_user(uarr + first * size, buf, k * size)
+                  : copy_from_user(buf, uarr + first * size, k * size);
+        if (err < 0 || k == n)
+                return err;
+        return out ? copy_to_user(uarr, (char *)buf + k * size, (n - k) * size)
+                   : copy_from_user((char *)buf + k * size, uarr, (n - k) * size);
+}
+
+/* Copies in the path an open or stat entry points at */
+static int
+ring_path(const ring_sqe_t *sqe, char **pathp)
+{
+        char *path;
+        int err;
+
+        if (sqe->sqe_len >= MAXPATHLEN)
+                return -ENAMETOOLONG;
+        if (NULL == (path = kmalloc(sqe->sqe_len + 1)))
+                return -ENOMEM;
+        if ((err = copy_from_user(path, sqe->sqe_addr, sqe->sqe_len)) < 0) {
+                kfree(path);
+                return err;
+        }
+        path[sqe->sqe_len] = '\0';
+        *pathp = path;
+        return 0;
+}
+
+/* Carries out one entry; returns what the equivalent syscall would, or
+ * -errno */
+static int
+ring_op(const ring_sqe_t *sqe)
+{
+        struct stat st;
+        char *path;
+        int ret;
+
+        switch (sqe->sqe_op) {
+                case RING_OP_NOP:
+                        return 0;
+
+                case RING_OP_READ:
+                        return user_file_io(sqe->sqe_fd, sqe->sqe_addr, sqe->sqe_len, NULL, 0);
+
+                case RING_OP_WRITE:
+                        return user_file_io(sqe->sqe_fd, sqe->sqe_addr, sqe->sqe_len, NULL, 1);
+
+                case RING_OP_CLOSE:
+                        return do_close(sqe->sqe_fd);
+
+                case RING_OP_OPEN:
+                        if ((ret = ring_path(sqe, &path)) < 0)
+                                return ret;
+                        ret = do_open(path, sqe->sqe_flags);
+                        kfree(path);
+                        return ret;
+
+                case RING_OP_STAT:
+                        if ((ret = ring_path(sqe, &path)) < 0)
+                                return ret;
+                        if (0 == (ret = do_stat(path, &st)))
+                                ret = copy_to_user(sqe->sqe_addr2, &st, sizeof(st));
+                        kfree(path);
+                        return ret;
+
+                default:
+                        return -EINVAL;
+        }
+}
+
+/*
+ * Entries are copied in RING_BATCH at a time, carried out in order and
+ * their completions copied out together, so a full ring costs a handful
+ * of copies rather than a trap and an argument copy per operation. A
+ * failed operation only fails its own completion.
+ *
+ * An operation cannot be undone, so the completion array and the kernel
+ * half of the header are checked for write access before anything runs,
+ * and the new sq head and cq tail are published after every batch: once
+ * an entry has been carried out it is never run again.
+ */
+int
+do_submit(ring_hdr_t *uring, uint32_t count)
+{
+        ring_sqe_t sqes[RING_BATCH];
+        ring_cqe_t cqes[RING_BATCH];
+        ring_hdr_t hdr;
+        uint32_t n, i, done = 0;
+        int err, perr;
+
+        if ((err = copy_from_user(&hdr, uring, sizeof(hdr))) < 0)
+                return err;
+        if (RING_MAGIC != hdr.rh_magic || !RING_VALID_SIZE(hdr.rh_sq_entries)
+            || hdr.rh_cq_entries != 2 * hdr.rh_sq_entries
+            || hdr.rh_sq_off != RING_SQ_OFF
+            || hdr.rh_cq_off != hdr.rh_sq_off + hdr.rh_sq_entries * sizeof(ring_sqe_t)
+            || hdr.rh_sq_tail - hdr.rh_sq_head > hdr.rh_sq_entries
+            || hdr.rh_cq_tail - hdr.rh_cq_head > hdr.rh_cq_entries)
+                return -EINVAL;
+        if (!range_perm(curproc, &uring->rh_sq_head, 2 * sizeof(uint32_t), PROT_WRITE)
+            || !range_perm(curproc, (char *)uring + hdr.rh_cq_off,
+                           hdr.rh_cq_entries * sizeof(ring_cqe_t), PROT_WRITE))
+                return -EFAULT;
+
+        count = MIN(count, hdr.rh_sq_tail - hdr.rh_sq_head);
+        count = MIN(count, hdr.rh_cq_entries - (hdr.rh_cq_tail - hdr.rh_cq_head));
+
+        while (done < count) {
+                n = MIN(count - done, RING_BATCH);
+                if ((err = ring_copy((char *)uring + hdr.rh_sq_off, sizeof(ring_sqe_t),
+                                     hdr.rh_sq_entries, hdr.rh_sq_head, sqes, n, 0)) < 0)
+                        break;
+                for (i = 0; i < n; ++i) {
+                        cqes[i].cqe_data = sqes[i].sqe_data;
+                        cqes[i].cqe_res = ring_op(&sqes[i]);
+                }
+                /* the entries have run whether or not their completions
+                 * make it out, so they are consumed either way */
+                err = ring_copy((char *)uring + hdr.rh_cq_off, sizeof(ring_cqe_t),
+                                hdr.rh_cq_entries, hdr.rh_cq_tail, cqes, n, 1);
+                hdr.rh_sq_head += n;
+                hdr.rh_cq_tail += n;
+                done += n;
+                perr = copy_to_user(&uring->rh_sq_head, &hdr.rh_sq_head,
+                                    2 * sizeof(uint32_t));
+                if (err < 0 || perr < 0)
+                        break;
+        }
+
+        return (err < 0 && 0 == done) ? err : (int)done;
+}
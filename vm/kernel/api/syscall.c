@@ -29,7 +29,9 @@
 #include "util/init.h"
 #include "util/string.h"
 #include "util/debug.h"
+#include "util/trace.h"
 #include "util/list.h"
+#include "util/tsc.h"
 
 #include "mm/mman.h"
 #include "mm/mm.h"
@@ -39,17 +41,31 @@
 
 #include "fs/vfs_syscall.h"
 #include "fs/vnode.h"
+#include "fs/file.h"
+#include "fs/stat.h"
+#include "fs/fdtable.h"
+#include "fs/uio.h"
+#include "fs/pipefs.h"
+#include "fs/aio.h"
 
 #include "test/kshell/kshell.h"
 
 #include "vm/brk.h"
 #include "vm/mmap.h"
 #include "vm/vmmap.h"
+#include "vm/kdata.h"
 
 #include "api/syscall.h"
 #include "api/utsname.h"
 #include "api/access.h"
 #include "api/exec.h"
+#include "api/syscall_ext.h"
+#include "api/user_page.h"
+#include "api/ring.h"
+#include "api/syscall_stats.h"
+
+/* Most directory entries sys_getdents reads in one VFS call */
+#define GETDENTS_BATCH  (PAGE_SIZE / sizeof(dirent_t))
 
 static void syscall_handler(regs_t *regs);
 static int syscall_dispatch(uint32_t sysnum, uint32_t args, regs_t *regs);
@@ -60,14 +76,199 @@ static __attribute__((unused)) void syscall_init(void)
 }
 init_func(syscall_init);
 
+/* Nonzero unless fd is open on something other than a regular file. A
+ * bad fd counts as regular; the VFS call will reject it. */
+static int
+fd_is_regular(int fd)
+{
+        file_t *file = fd_lookup(curproc, fd);
+        return NULL == file || S_ISREG(file->f_vnode->vn_mode);
+}
+
+/* Moves len bytes between kbuf and the user buffers uiov, starting off
+ * bytes into uiov[i] */
+static int
+user_iov_copy(const struct iovec *uiov, int iovcnt, int i, size_t off,
+              char *kbuf, size_t len, int out)
+{
+        size_t done = 0, piece;
+        int err;
+
+        for (; done < len && i < iovcnt; ++i, off = 0) {
+                piece = MIN(uiov[i].iov_len - off, len - done);
+                if (0 == piece)
+                        continue;
+                err = out ? copy_to_user((char *)uiov[i].iov_base + off, kbuf + done, piece)
+                          : copy_from_user(kbuf + done, (char *)uiov[i].iov_base + off, piece);
+                if (err < 0)
+                        return err;
+                done += piece;
+        }
+        return 0;
+}
+
+/*
+ * user_file_io and user_file_iov for anything but a regular file. A pipe
+ * or tty may block on a second call even though the first one moved
+ * data, and a pipe write of up to PIPE_BUF bytes has to reach the pipe
+ * in one call, so data goes through a kernel page instead of straight
+ * to and from the user's pages: a read is a single call for at most a
+ * page, and a write is made a page at a time, each gathered from as many
+ * of the user's buffers as it covers.
+ */
+static int
+user_stream_io(int fd, const struct iovec *uiov, int iovcnt, int iswrite)
+{
+        uint32_t total = 0;
+        size_t off = 0, want, skip;
+        int i = 0, k, len, err = 0;
+        char *kbuf;
+
+        if (NULL == (kbuf = (char *)page_alloc()))
+                return -ENOMEM;
+        while (1) {
+                want = 0;
+                for (k = i, skip = off; k < iovcnt && want < PAGE_SIZE; ++k, skip = 0)
+                        want += MIN(uiov[k].iov_len - skip, PAGE_SIZE - want);
+                if (0 == want)
+                        break;
+
+                if (iswrite && (err = user_iov_copy(uiov, iovcnt, i, off, kbuf, want, 0)) < 0)
+                        break;
+                len = iswrite ? do_write(fd, kbuf, want) : do_read(fd, kbuf, want);
+                if (len < 0) {
+                        err = len;
+                        break;
+                }
+                if (!iswrite && (err = user_iov_copy(uiov, iovcnt, i, off, kbuf, len, 1)) < 0)
+                        break;
+                total += len;
+                if (!iswrite || (size_t)len < want)
+                        break;
+
+                /* step past what was written */
+                while (i < iovcnt && (size_t)len >= uiov[i].iov_len - off) {
+                        len -= uiov[i].iov_len - off;
+                        i++;
+                        off = 0;
+                }
+                off += len;
+        }
+        page_free(kbuf);
+        return (err < 0 && 0 == total) ? err : (int)total;
+}
+
+/*
+ * Moves up to nbytes between fd and the user buffer ubuf without a bounce
+ * buffer: each user page in turn is pinned with user_page_get and its
+ * kernel address handed to the VFS, so the file system copies straight
+ * between its page cache and the user's page. With a NULL offset this is
+ * read/write at f_pos, otherwise pread/pwrite at *offset. Stops at the
+ * first short transfer. Returns the number of bytes moved, or -errno if
+ * nothing could be moved.
+ *
+ * Only regular files are worth splitting at page boundaries like this;
+ * read and write on anything else go through user_stream_io, and pread
+ * and pwrite on it stop after the first page that moves data.
+ */
+int
+user_file_io(int fd, void *ubuf, size_t nbytes, const off_t *offset, int iswrite)
+{
+        int regular = fd_is_regular(fd);
+        uint32_t done = 0;
+        pframe_t *pf;
+        int len = 0;
+
+        if (!regular && NULL == offset) {
+                struct iovec iov = { ubuf, nbytes };
+                return user_stream_io(fd, &iov, 1, iswrite);
+        }
+
+        while (done < nbytes) {
+                uint32_t addr = (uint32_t)ubuf + done;
+                size_t chunk = MIN(PAGE_SIZE - PAGE_OFFSET(addr), nbytes - done);
+                char *kaddr;
+
+                /* reading from the file writes the user's page */
+                if ((len = user_page_get((void *)addr, !iswrite, &pf)) < 0)
+                        break;
+                kaddr = (char *)pf->pf_addr + PAGE_OFFSET(addr);
+                if (iswrite)
+                        len = (NULL == offset) ? do_write(fd, kaddr, chunk)
+                                               : do_pwrite(fd, kaddr, chunk, *offset + done);
+                else
+                        len = (NULL == offset) ? do_read(fd, kaddr, chunk)
+                                               : do_pread(fd, kaddr, chunk, *offset + done);
+                user_page_put(pf);
+                if (len < 0)
+                        break;
+                done += len;
+                if ((size_t)len < chunk || (!regular && 0 < len))
+                        break;
+        }
+        return (len < 0 && 0 == done) ? len : (int)done;
+}
+
+/*
+ * The vectored version of user_file_io. Each round pins a page-sized
+ * piece of as many of the user's buffers as fit in IOV_MAX kernel iovecs
+ * and passes them all to do_readv/do_writev in a single call. Files other
+ * than regular ones go through user_stream_io, as for user_file_io.
+ */
+static int
+user_file_iov(int fd, const struct iovec *uiov, int iovcnt, int iswrite)
+{
+        struct iovec kiov[IOV_MAX];
+        pframe_t *pfs[IOV_MAX];
+        uint32_t total = 0;
+        size_t off = 0, want;
+        int i = 0, n, k, got, err = 0;
+
+        if (!fd_is_regular(fd))
+                return user_stream_io(fd, uiov, iovcnt, iswrite);
+
+        while (i < iovcnt) {
+                want = 0;
+                n = 0;
+                while (n < IOV_MAX && i < iovcnt) {
+                        if (off == uiov[i].iov_len) {
+                                i++;
+                                off = 0;
+                                continue;
+                        }
+                        uint32_t addr = (uint32_t)uiov[i].iov_base + off;
+                        size_t len = MIN(PAGE_SIZE - PAGE_OFFSET(addr), uiov[i].iov_len - off);
+                        if ((err = user_page_get((void *)addr, !iswrite, &pfs[n])) < 0)
+                                break;
+                        kiov[n].iov_base = (char *)pfs[n]->pf_addr + PAGE_OFFSET(addr);
+                        kiov[n].iov_len = len;
+                        want += len;
+                        off += len;
+                        n++;
+                }
+                if (0 == n)
+                        break;
+
+                got = iswrite ? do_writev(fd, kiov, n) : do_readv(fd, kiov, n);
+                for (k = 0; k < n; ++k)
+                        user_page_put(pfs[k]);
+                if (got < 0) {
+                        err = got;
+                        break;
+                }
+                total += got;
+                if ((size_t)got < want || err < 0)
+                        break;
+        }
+        return (err < 0 && 0 == total) ? err : (int)total;
+}
+
 /*
  * this is one of the few sys_* functions you have to write. be sure to
  * check out the sys_* functions we have provided before trying to write
  * this one.
  *  - copy_from_user() the read_args_t
- *  - page_alloc() a temporary buffer
- *  - call do_read(), and copy_to_user() the read bytes
- *  - page_free() your buffer
+ *  - call do_read() on each page of the user's buffer (user_file_io)
  *  - return the number of bytes actually read, or if anything goes wrong
  *    set curthr->kt_errno and return -1
  */
@@ -76,43 +277,18 @@ sys_read(read_args_t *arg)
 {
         read_args_t kern_args;
         int err;
-	copy_from_user(&kern_args, arg, sizeof(kern_args));
-	/*err = copy_from_user(&kern_args, arg, sizeof(kern_args));
-        if (err < 0) {
+
+        if ((err = copy_from_user(&kern_args, arg, sizeof(kern_args))) < 0) {
                 curthr->kt_errno = -err;
                 return -1;
-        }*/
-        void *buf = page_alloc();
-        /*if (NULL == buf) {
-                curthr->kt_errno = ENOMEM;
+        }
+        if ((err = user_file_io(kern_args.fd, kern_args.buf, kern_args.nbytes, NULL, 0)) < 0) {
+                curthr->kt_errno = -err;
+                grading_dbg("(GRADING3D 1)\n");
                 return -1;
-        }*/
-        uint32_t readlen = 0;
-        while (readlen < kern_args.nbytes) {
-                int len = 0;
-                if ((len = do_read(kern_args.fd, buf, MIN(PAGE_SIZE, kern_args.nbytes - readlen))) < 0) {
-                        curthr->kt_errno = -len;
-                        page_free(buf);
-                        dbg(DBG_PRINT, "(GRADING3D 1)\n");
-                        return -1;
-                }
-		copy_to_user((void *)((uint32_t)arg->buf + readlen), buf, len);
-		/*err = copy_to_user((void *)((uint32_t)arg->buf + readlen), buf, len);
-                if (err < 0) {
-                        curthr->kt_errno = -err;
-                        page_free(buf);
-                        return -1;
-                }*/
-                readlen += (uint32_t)len;
-                if ((uint32_t)len < MIN(PAGE_SIZE, kern_args.nbytes - readlen)) {
-                        dbg(DBG_PRINT, "(GRADING3A)\n");
-                        break;
-                }
-                dbg(DBG_PRINT, "(GRADING3D 1)\n");
         }
-        page_free(buf);
-        dbg(DBG_PRINT, "(GRADING3A)\n");
-        return readlen;
+        grading_dbg("(GRADING3A)\n");
+        return err;
 }
 
 /*
@@ -123,82 +299,229 @@ sys_write(write_args_t *arg)
 {
         write_args_t kern_args;
         int err;
-	copy_from_user(&kern_args, arg, sizeof(kern_args));
-	/*err = copy_from_user(&kern_args, arg, sizeof(kern_args));
-        if (err < 0) {
+
+        if ((err = copy_from_user(&kern_args, arg, sizeof(kern_args))) < 0) {
                 curthr->kt_errno = -err;
                 return -1;
-        }*/
-
-        void *buf = page_alloc();
-        /*if (NULL == buf) {
-                curthr->kt_errno = ENOMEM;
+        }
+        if ((err = user_file_io(kern_args.fd, (void *)kern_args.buf, kern_args.nbytes, NULL, 1)) < 0) {
+                curthr->kt_errno = -err;
+                grading_dbg("(GRADING3D 1)\n");
                 return -1;
-        }*/
-        uint32_t writelen = 0;
-        while (writelen < kern_args.nbytes) {
-		copy_from_user(buf, (void *)((uint32_t)kern_args.buf + writelen), kern_args.nbytes - writelen);
-		/*err = copy_from_user(buf, (void *)((uint32_t)kern_args.buf + writelen), kern_args.nbytes - writelen);
-                if (err < 0) {
-                        curthr->kt_errno = -err;
-                        page_free(buf);
-                        return -1;
-                }*/
-                int len = 0;
-                if ((len += do_write(kern_args.fd, buf, kern_args.nbytes)) < 0) {
-                        curthr->kt_errno = -len;
-                        page_free(buf);
-                        dbg(DBG_PRINT, "(GRADING3D 1)\n");
-                        return -1;
-                }
-                writelen += (uint32_t)len;
-                dbg(DBG_PRINT, "(GRADING3A)\n");
         }
-        page_free(buf);
-        dbg(DBG_PRINT, "(GRADING3A)\n");
-        return writelen;
+        grading_dbg("(GRADING3A)\n");
+        return err;
 }
 
 /*
- * This is another tricly sys_* function that you will need to write.
- * It's pretty similar to sys_read(), but you don't need
- * to allocate a whole page, just a single dirent_t. call do_getdent in a
- * loop until you have read getdent_args_t->count bytes (or an error
- * occurs).  You should note that count is the number of bytes in the
- * buffer, not the number of dirents, which means that you'll need to loop
- * a max of something like count / sizeof(dirent_t) times.
+ * Reads as many whole dirent_t's as fit in getdents_args_t->count bytes
+ * (count is a byte count, not a number of entries). Entries are read
+ * in batches with do_getdents into a kernel page, and each batch is
+ * copied out with one copy_to_user, rather than a do_getdent, an lseek
+ * and a copy_to_user for every entry.
  */
 static int
 sys_getdents(getdents_args_t *arg)
 {
         getdents_args_t kern_args;
-        int err;
-	err = copy_from_user(&kern_args, arg, sizeof(kern_args));
-        /*if (err < 0) {
+        dirent_t *kdirs;
+        uint32_t want, done = 0;
+        int err, n;
+
+        if ((err = copy_from_user(&kern_args, arg, sizeof(kern_args))) < 0) {
                 curthr->kt_errno = -err;
                 return -1;
-        }*/
-        dirent_t dirp;
-        uint32_t count;
-        for (count = 0; count < kern_args.count / sizeof(dirent_t); count++) {
-                if ((err = do_getdent(kern_args.fd, &dirp)) < 0) {
-                        curthr->kt_errno = -err;
-                        dbg(DBG_PRINT, "(GRADING3D 1)\n");
-                        return -1;
+        }
+        if (NULL == (kdirs = page_alloc())) {
+                curthr->kt_errno = ENOMEM;
+                return -1;
+        }
+
+        /* a page of entries per round, copied out with a single
+         * copy_to_user; most directories take one round */
+        want = kern_args.count / sizeof(dirent_t);
+        while (done < want) {
+                /* do_getdents moves f_pos past the batch; if it cannot be
+                 * copied out, put f_pos back so no entry is skipped. Only
+                 * our own threads could close fd, so file stays valid. */
+                file_t *file = fd_lookup(curproc, kern_args.fd);
+                off_t pos = (NULL == file) ? 0 : file->f_pos;
+
+                n = do_getdents(kern_args.fd, kdirs, MIN(want - done, GETDENTS_BATCH));
+                if (n <= 0) {
+                        err = n;
+                        break;
                 }
-                if (0 == err) {
-                        dbg(DBG_PRINT, "(GRADING3A)\n");
+                if ((err = copy_to_user(kern_args.dirp + done, kdirs, n * sizeof(dirent_t))) < 0) {
+                        file->f_pos = pos;
                         break;
                 }
-		err = copy_to_user(arg->dirp + count, &dirp, sizeof(dirent_t));
-                /*if (err < 0) {
+                done += n;
+        }
+        page_free(kdirs);
+
+        if (err < 0 && 0 == done) {
+                curthr->kt_errno = -err;
+                return -1;
+        }
+        return done * sizeof(dirent_t);
+}
+
+/*
+ * pread(2) and pwrite(2): sys_read and sys_write at an explicit offset,
+ * leaving f_pos alone.
+ */
+static int sys_pread(pio_args_t *arg)
+{
+        pio_args_t              kargs;
+        int                     err;
+
+        if ((err = copy_from_user(&kargs, arg, sizeof(kargs))) < 0) {
+                curthr->kt_errno = -err;
+                return -1;
+        }
+        if ((err = user_file_io(kargs.fd, kargs.buf, kargs.nbytes, &kargs.offset, 0)) < 0) {
+                curthr->kt_errno = -err;
+                return -1;
+        }
+        return err;
+}
+
+static int sys_pwrite(pio_args_t *arg)
+{
+        pio_args_t              kargs;
+        int                     err;
+
+        if ((err = copy_from_user(&kargs, arg, sizeof(kargs))) < 0) {
+                curthr->kt_errno = -err;
+                return -1;
+        }
+        if ((err = user_file_io(kargs.fd, kargs.buf, kargs.nbytes, &kargs.offset, 1)) < 0) {
+                curthr->kt_errno = -err;
+                return -1;
+        }
+        return err;
+}
+
+/* readv(2) and writev(2) */
+static int sys_iov(iov_args_t *arg, int iswrite)
+{
+        iov_args_t              kargs;
+        struct iovec            uiov[IOV_MAX];
+        int                     err;
+
+        if ((err = copy_from_user(&kargs, arg, sizeof(kargs))) < 0) {
+                curthr->kt_errno = -err;
+                return -1;
+        }
+        if (kargs.iovcnt <= 0 || kargs.iovcnt > IOV_MAX) {
+                curthr->kt_errno = EINVAL;
+                return -1;
+        }
+        if ((err = copy_from_user(uiov, kargs.iov, kargs.iovcnt * sizeof(struct iovec))) < 0) {
+                curthr->kt_errno = -err;
+                return -1;
+        }
+        if ((err = user_file_iov(kargs.fd, uiov, kargs.iovcnt, iswrite)) < 0) {
+                curthr->kt_errno = -err;
+                return -1;
+        }
+        return err;
+}
+
+/* sendfile(2) */
+static int sys_sendfile(sendfile_args_t *arg)
+{
+        sendfile_args_t         kargs;
+        off_t                   off;
+        int                     err, ret;
+
+        if ((err = copy_from_user(&kargs, arg, sizeof(kargs))) < 0) {
+                curthr->kt_errno = -err;
+                return -1;
+        }
+        /* the new offset is written back after the data has moved, when
+         * it is too late to fail, so make sure it can be written first */
+        if (NULL != kargs.offset) {
+                if ((err = copy_from_user(&off, kargs.offset, sizeof(off))) < 0) {
                         curthr->kt_errno = -err;
                         return -1;
-                }*/
-		dbg(DBG_PRINT, "(GRADING3A)\n");
+                }
+                if (!range_perm(curproc, kargs.offset, sizeof(off), PROT_WRITE)) {
+                        curthr->kt_errno = EFAULT;
+                        return -1;
+                }
+        }
+
+        ret = do_sendfile(kargs.out_fd, kargs.in_fd,
+                          (NULL == kargs.offset) ? NULL : &off, kargs.count);
+        if (ret < 0) {
+                curthr->kt_errno = -ret;
+                return -1;
+        }
+
+        /* the transfer is done, so it is reported even if this fails */
+        if (NULL != kargs.offset)
+                copy_to_user(kargs.offset, &off, sizeof(off));
+        return ret;
+}
+
+/* Maps a submission/completion ring of the given size */
+static void *sys_ring_setup(uint32_t entries)
+{
+        void                    *ret;
+        int                     err;
+
+        if ((err = do_ring_setup(entries, &ret)) < 0) {
+                curthr->kt_errno = -err;
+                return MAP_FAILED;
+        }
+        return ret;
+}
+
+/* Carries out a batch of entries from a ring */
+static int sys_submit(submit_args_t *arg)
+{
+        submit_args_t           kargs;
+        int                     err;
+
+        if ((err = copy_from_user(&kargs, arg, sizeof(kargs))) < 0) {
+                curthr->kt_errno = -err;
+                return -1;
+        }
+        if ((err = do_submit(kargs.ring, kargs.count)) < 0) {
+                curthr->kt_errno = -err;
+                return -1;
+        }
+        return err;
+}
+
+/* aio_read and aio_write: queue a pread or pwrite, returning its id */
+static int sys_aio_submit(pio_args_t *arg, int iswrite)
+{
+        pio_args_t              kargs;
+        int                     err;
+
+        if ((err = copy_from_user(&kargs, arg, sizeof(kargs))) < 0) {
+                curthr->kt_errno = -err;
+                return -1;
         }
-        dbg(DBG_PRINT, "(GRADING3A)\n");
-        return count * sizeof(dirent_t);
+        if ((err = do_aio_submit(kargs.fd, kargs.buf, kargs.nbytes, kargs.offset, iswrite)) < 0) {
+                curthr->kt_errno = -err;
+                return -1;
+        }
+        return err;
+}
+
+static int sys_aio_wait(int id)
+{
+        int                     err;
+
+        if ((err = do_aio_wait(id)) < 0) {
+                curthr->kt_errno = -err;
+                return -1;
+        }
+        return err;
 }
 
 #ifdef __MOUNTING__
@@ -646,7 +969,11 @@ static int sys_pipe(int arg[2])
         int kern_args[2];
         int ret;
 
+#ifdef __PIPES__
+        ret = pipefs_pipe(kern_args);
+#else
         ret = do_pipe(kern_args);
+#endif
 
         if (ret == 0) {
                 ret = copy_to_user(arg, kern_args, sizeof(kern_args));
@@ -662,10 +989,9 @@ static int sys_pipe(int arg[2])
 
 static int sys_uname(struct utsname *arg)
 {
-        static const char sysname[] = "Weenix";
-        static const char release[] = "1.2";
-        /* Version = last compilation time */
-        static const char version[] = "#1 " __DATE__ " " __TIME__;
+        static const char sysname[] = KDATA_SYSNAME;
+        static const char release[] = KDATA_RELEASE;
+        static const char version[] = KDATA_VERSION;
         static const char nodename[] = "";
         static const char machine[] = "";
         int ret = 0;
@@ -706,12 +1032,84 @@ static int sys_fork(regs_t *regs)
         return ret;
 }
 
-static void free_vector(char **vect)
+/* Most bytes of arguments and environment sys_execve will copy in */
+#define EXECVE_ARGS_MAX (64 * 1024)
+
+/*
+ * Copies execve's argument and environment vectors into one kmalloc'd
+ * arena: the argv pointer array, then the envp one, then the strings.
+ * Strings that sit back to back in user memory (as they do when a
+ * program passes on the vectors it was started with) are copied with a
+ * single copy_from_user per run rather than a kmalloc and a copy each.
+ * A vector whose av_vec is NULL comes back NULL. Everything is freed
+ * with one kfree of *arenap.
+ */
+static int
+execve_copy_args(const argvec_t *uargv, const argvec_t *uenvp,
+                 void **arenap, char ***argvp, char ***envpp)
 {
-        char **temp;
-        for (temp = vect; *temp; temp++)
-                kfree(*temp);
-        kfree(vect);
+        size_t argc = uargv->av_vec ? uargv->av_len : 0;
+        size_t envc = uenvp->av_vec ? uenvp->av_len : 0;
+        size_t n = argc + envc, bytes = 0, ptrs, run, i, j;
+        argstr_t *strs;
+        char **argv, **envp, *dst;
+        int err = 0;
+
+        if (argc > EXECVE_ARGS_MAX / sizeof(argstr_t) || envc > EXECVE_ARGS_MAX / sizeof(argstr_t))
+                return -E2BIG;
+        if (NULL == (strs = (argstr_t *)kmalloc((n + 1) * sizeof(argstr_t))))
+                return -ENOMEM;
+        if (0 < argc && (err = copy_from_user(strs, uargv->av_vec, argc * sizeof(argstr_t))) < 0)
+                goto out;
+        if (0 < envc && (err = copy_from_user(strs + argc, uenvp->av_vec, envc * sizeof(argstr_t))) < 0)
+                goto out;
+
+        for (i = 0; i < n; ++i) {
+                bytes += strs[i].as_len + 1;
+                if (strs[i].as_len >= EXECVE_ARGS_MAX || bytes > EXECVE_ARGS_MAX) {
+                        err = -E2BIG;
+                        goto out;
+                }
+        }
+        ptrs = (argc + 1 + envc + 1) * sizeof(char *);
+        if (NULL == (argv = (char **)kmalloc(ptrs + bytes))) {
+                err = -ENOMEM;
+                goto out;
+        }
+        envp = argv + argc + 1;
+
+        dst = (char *)argv + ptrs;
+        for (i = 0; i < n; i = j) {
+                run = strs[i].as_len + 1;
+                for (j = i + 1; j < n && strs[j].as_str == strs[j - 1].as_str + strs[j - 1].as_len + 1; ++j)
+                        run += strs[j].as_len + 1;
+                if ((err = copy_from_user(dst, strs[i].as_str, run)) < 0) {
+                        kfree(argv);
+                        goto out;
+                }
+                dst += run;
+        }
+
+        /* point the vectors into the arena, terminating every string
+         * whatever the user left there */
+        dst = (char *)argv + ptrs;
+        for (i = 0; i < n; ++i) {
+                if (i < argc)
+                        argv[i] = dst;
+                else
+                        envp[i - argc] = dst;
+                dst[strs[i].as_len] = '\0';
+                dst += strs[i].as_len + 1;
+        }
+        argv[argc] = NULL;
+        envp[envc] = NULL;
+
+        *arenap = argv;
+        *argvp = uargv->av_vec ? argv : NULL;
+        *envpp = uenvp->av_vec ? envp : NULL;
+out:
+        kfree(strs);
+        return err;
 }
 
 static int sys_execve(execve_args_t *args, regs_t *regs)
@@ -720,6 +1118,7 @@ static int sys_execve(execve_args_t *args, regs_t *regs)
         char *kern_filename = NULL;
         char **kern_argv = NULL;
         char **kern_envp = NULL;
+        void *kern_arena = NULL;
         int err;
 
         if ((err = copy_from_user(&kern_args, args, sizeof(kern_args))) < 0) {
@@ -731,29 +1130,30 @@ static int sys_execve(execve_args_t *args, regs_t *regs)
         if ((kern_filename = user_strdup(&kern_args.filename)) == NULL)
                 goto cleanup;
 
-        /* copy the argument list */
-        if (kern_args.argv.av_vec) {
-                if ((kern_argv = user_vecdup(&kern_args.argv)) == NULL)
-                        goto cleanup;
-        }
-
-        /* copy the environment list */
-        if (kern_args.envp.av_vec) {
-                if ((kern_envp = user_vecdup(&kern_args.envp)) == NULL)
-                        goto cleanup;
+        /* copy the argument and environment lists */
+        if ((err = execve_copy_args(&kern_args.argv, &kern_args.envp,
+                                    &kern_arena, &kern_argv, &kern_envp)) < 0) {
+                curthr->kt_errno = -err;
+                goto cleanup;
         }
 
         err = do_execve(kern_filename, kern_argv, kern_envp, regs);
+        if (0 == err) {
+                /* the old image is gone, so there is nothing to fail back
+                 * to; the first touch of the page retries the mapping */
+                int kerr = kdata_map(curproc);
+                if (kerr < 0)
+                        dbg(DBG_VM, "pid %d: mapping kernel data page failed: %d\n",
+                            curproc->p_pid, kerr);
+        }
 
         curthr->kt_errno = -err;
 
 cleanup:
         if (kern_filename)
                 kfree(kern_filename);
-        if (kern_argv)
-                free_vector(kern_argv);
-        if (kern_envp)
-                free_vector(kern_envp);
+        if (kern_arena)
+                kfree(kern_arena);
         if (curthr->kt_errno)
                 return -1;
         return 0;
@@ -819,7 +1219,14 @@ static void syscall_handler(regs_t *regs)
 
         dbginfo(DBG_VMMAP, vmmap_mapping_info, curproc->p_vmmap);
 
-        int ret = syscall_dispatch(sysnum, args, regs);
+        int ret;
+        if (syscall_stats_enabled) {
+                uint64_t start = rdtsc();
+                ret = syscall_dispatch(sysnum, args, regs);
+                syscall_stats_record(sysnum, rdtsc() - start);
+        } else {
+                ret = syscall_dispatch(sysnum, args, regs);
+        }
 
         if (curthr->kt_cancelled) {
                 dbg(DBG_SYSCALL, "trap: CANCELLING: thread %p of proc %d "
@@ -890,6 +1297,36 @@ static int syscall_dispatch(uint32_t sysnum, uint32_t args, regs_t *regs)
                 case SYS_write:
                         return sys_write((write_args_t *)args);
 
+                case SYS_pread:
+                        return sys_pread((pio_args_t *)args);
+
+                case SYS_pwrite:
+                        return sys_pwrite((pio_args_t *)args);
+
+                case SYS_readv:
+                        return sys_iov((iov_args_t *)args, 0);
+
+                case SYS_writev:
+                        return sys_iov((iov_args_t *)args, 1);
+
+                case SYS_sendfile:
+                        return sys_sendfile((sendfile_args_t *)args);
+
+                case SYS_ring_setup:
+                        return (int)sys_ring_setup((uint32_t)args);
+
+                case SYS_submit:
+                        return sys_submit((submit_args_t *)args);
+
+                case SYS_aio_read:
+                        return sys_aio_submit((pio_args_t *)args, 0);
+
+                case SYS_aio_write:
+                        return sys_aio_submit((pio_args_t *)args, 1);
+
+                case SYS_aio_wait:
+                        return sys_aio_wait((int)args);
+
                 case SYS_dup:
                         return sys_dup((int)args);
 
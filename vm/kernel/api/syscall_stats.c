@@ -0,0 +1,298 @@
+/******************************************************************************/
+/* Important Spring 2020 CSCI 402 usage information:                          */
+/*                                                                            */
+/* This fils is part of CSCI 402 kernel programming assignments at USC.       */
+/*         53616c7465645f5fd1e93dbf35cbffa3aef28f8c01d8cf2ffc51ef62b26a       */
+/*         f9bda5a68e5ed8c972b17bab0f42e24b19daa7bd408305b1f7bd6c7208c1       */
+/*         0e36230e913039b3046dd5fd0ba706a624d33dbaa4d6aab02c82fe09f561       */
+/*         01b0fd977b0051f0b0ce0c69f7db857b1b5e007be2db6d42894bf93de848       */
+/*         806d9152bd5715e9                                                   */
+/* Please understand that you are NOT permitted to distribute or publically   */
+/*         display a copy of this file (or ANY PART of it) for any reason.    */
+/* If anyone (including your prospective employer) asks you to post the code, */
+/*         you must inform them that you do NOT have permissions to do so.    */
+/* You are also NOT permitted to remove or alter this comment block.          */
+/* If this comment block is removed or altered in a submitted file, 20 points */
+/*         will be deducted.                                                  */
+/******************************************************************************/
+
+#include "kernel.h"
+#include "globals.h"
+#include "types.h"
+#include "errno.h"
+
+#include "util/init.h"
+#include "util/debug.h"
+#include "util/string.h"
+#include "util/printf.h"
+#include "util/list.h"
+#include "util/tsc.h"
+
+#include "proc/proc.h"
+
+#include "mm/page.h"
+#include "mm/kmalloc.h"
+#include "mm/mmobj.h"
+
+#include "fs/vnode.h"
+
+#include "vm/vmmap.h"
+
+#include "drivers/dev.h"
+#include "drivers/bytedev.h"
+
+#include "api/syscall_stats.h"
+
+#include "test/kshell/kshell.h"
+
+/* Room for the text form of the statistics */
+#define SYSCALL_STATS_TEXT_PAGES        4
+
+int syscall_stats_enabled = 0;
+
+static syscall_stats_t syscall_stats[SYSCALL_STATS_NR];
+
+void
+syscall_stats_record(uint32_t sysnum, uint64_t cycles)
+{
+        proc_syscall_stats_t **psp = proc_syscall_stats(curproc);
+        syscall_stats_t *st;
+        int b = tsc_log2(cycles);
+
+        if (sysnum >= SYSCALL_STATS_NR)
+                sysnum = SYSCALL_STATS_NR - 1;
+        if (b >= SYSCALL_HIST_BUCKETS)
+                b = SYSCALL_HIST_BUCKETS - 1;
+
+        st = &syscall_stats[sysnum];
+        st->st_count++;
+        st->st_cycles += cycles;
+        st->st_hist[b]++;
+
+        if (NULL == *psp) {
+                if (NULL == (*psp = kmalloc(sizeof(proc_syscall_stats_t))))
+                        return;
+                memset(*psp, 0, sizeof(proc_syscall_stats_t));
+        }
+        (*psp)->ps_count[sysnum]++;
+        (*psp)->ps_cycles[sysnum] += cycles;
+}
+
+/* Mean of cycles over count calls, without 64-bit division */
+static uint32_t
+syscall_stats_avg(uint64_t cycles, uint32_t count)
+{
+        while (cycles >> 32) {
+                cycles >>= 1;
+                count >>= 1;
+        }
+        if (0 == count)
+                return cycles ? 0xffffffff : 0;
+        return (uint32_t)cycles / count;
+}
+
+/* Formats the system-wide statistics, or those of the process arg if it
+ * is not NULL. Returns the space left in buf, as the other *_info
+ * routines do. */
+static size_t
+syscall_stats_info(const void *arg, char *buf, size_t osize)
+{
+        const proc_t *p = (const proc_t *)arg;
+        size_t size = osize;
+        int nr, b;
+
+        if (NULL != p) {
+                proc_syscall_stats_t *ps = *proc_syscall_stats((proc_t *)p);
+                iprintf(&buf, &size, "pid %d (%s)\n%4s %10s %12s\n",
+                        p->p_pid, p->p_comm, "NR", "CALLS", "AVG CYCLES");
+                for (nr = 0; NULL != ps && nr < SYSCALL_STATS_NR; ++nr) {
+                        if (ps->ps_count[nr])
+                                iprintf(&buf, &size, "%4d %10u %12u\n", nr, ps->ps_count[nr],
+                                        syscall_stats_avg(ps->ps_cycles[nr], ps->ps_count[nr]));
+                }
+                return size;
+        }
+
+        iprintf(&buf, &size, "syscall profiling %s\n%4s %10s %12s  %s\n",
+                syscall_stats_enabled ? "on" : "off",
+                "NR", "CALLS", "AVG CYCLES", "LOG2 CYCLES:CALLS");
+        for (nr = 0; nr < SYSCALL_STATS_NR; ++nr) {
+                const syscall_stats_t *st = &syscall_stats[nr];
+                if (0 == st->st_count)
+                        continue;
+                iprintf(&buf, &size, "%4d %10u %12u ", nr, st->st_count,
+                        syscall_stats_avg(st->st_cycles, st->st_count));
+                for (b = 0; b < SYSCALL_HIST_BUCKETS; ++b) {
+                        if (st->st_hist[b])
+                                iprintf(&buf, &size, " %d:%u", b, st->st_hist[b]);
+                }
+                iprintf(&buf, &size, "\n");
+        }
+        return size;
+}
+
+static void
+syscall_stats_reset(void)
+{
+        proc_t *p;
+
+        memset(syscall_stats, 0, sizeof(syscall_stats));
+        list_iterate_begin(proc_list(), p, proc_t, p_list_link) {
+                proc_syscall_stats_t *ps = *proc_syscall_stats(p);
+                if (NULL != ps)
+                        memset(ps, 0, sizeof(*ps));
+        } list_iterate_end();
+}
+
+/* ------------------------------------------------------------------ */
+/* ---------------------------- /dev/stats -------------------------- */
+/* ------------------------------------------------------------------ */
+
+/* Each read formats the statistics afresh and returns the part of the
+ * text at offset, so a reader that reads the whole file in several
+ * pieces may see numbers from more than one moment */
+static int
+syscall_stats_dev_read(bytedev_t *dev, int offset, void *buf, int count)
+{
+        size_t osize = SYSCALL_STATS_TEXT_PAGES * PAGE_SIZE;
+        char *text;
+        int len;
+
+        if (NULL == (text = page_alloc_n(SYSCALL_STATS_TEXT_PAGES)))
+                return -ENOMEM;
+        len = osize - syscall_stats_info(NULL, text, osize);
+        if (offset >= len) {
+                count = 0;
+        } else {
+                count = MIN(count, len - offset);
+                memcpy(buf, text + offset, count);
+        }
+        page_free_n(text, SYSCALL_STATS_TEXT_PAGES);
+        return count;
+}
+
+/* Writing "on", "off" or "reset" (a trailing newline is fine) does what
+ * the sysstat command of the same name does, so userland can drive the
+ * profiler, e.g. with echo on > /dev/stats */
+static int
+syscall_stats_dev_write(bytedev_t *dev, int offset, const void *buf, int count)
+{
+        char cmd[8];
+        int len = count;
+
+        if (len > 0 && '\n' == ((const char *)buf)[len - 1])
+                len--;
+        if (len <= 0 || len >= (int)sizeof(cmd))
+                return -EINVAL;
+        memcpy(cmd, buf, len);
+        cmd[len] = '\0';
+
+        if (0 == strcmp(cmd, "on"))
+                syscall_stats_enabled = 1;
+        else if (0 == strcmp(cmd, "off"))
+                syscall_stats_enabled = 0;
+        else if (0 == strcmp(cmd, "reset"))
+                syscall_stats_reset();
+        else
+                return -EINVAL;
+        return count;
+}
+
+static int
+syscall_stats_dev_mmap(vnode_t *file, vmarea_t *vma, mmobj_t **ret)
+{
+        return -ENODEV;
+}
+
+static bytedev_ops_t syscall_stats_dev_ops = {
+        .read = syscall_stats_dev_read,
+        .write = syscall_stats_dev_write,
+        .mmap = syscall_stats_dev_mmap,
+        .fillpage = NULL,
+        .dirtypage = NULL,
+        .cleanpage = NULL
+};
+
+static bytedev_t syscall_stats_dev = {
+        .cd_id = SYSCALL_STATS_DEVID,
+        .cd_ops = &syscall_stats_dev_ops
+};
+
+static __attribute__((unused)) void
+syscall_stats_dev_init(void)
+{
+        if (0 != bytedev_register(&syscall_stats_dev))
+                panic("could not register the syscall statistics device\n");
+}
+init_func(syscall_stats_dev_init);
+
+/* ------------------------------------------------------------------ */
+/* ------------------------- KSHELL COMMAND ------------------------- */
+/* ------------------------------------------------------------------ */
+
+/*
+ * sysstat            - system-wide counts, averages and histograms
+ * sysstat <pid>      - counts and averages for one process
+ * sysstat on | off   - start or stop profiling
+ * sysstat reset      - clear everything
+ */
+static int
+syscall_stats_cmd(kshell_t *ksh, int argc, char **argv)
+{
+        size_t osize = SYSCALL_STATS_TEXT_PAGES * PAGE_SIZE;
+        proc_t *p = NULL;
+        char *text, *line, *end;
+
+        if (argc > 2) {
+                kprintf(ksh, "usage: sysstat [pid | on | off | reset]\n");
+                return 0;
+        }
+
+        if (2 == argc) {
+                if (0 == strcmp(argv[1], "on")) {
+                        syscall_stats_enabled = 1;
+                        return 0;
+                }
+                if (0 == strcmp(argv[1], "off")) {
+                        syscall_stats_enabled = 0;
+                        return 0;
+                }
+                if (0 == strcmp(argv[1], "reset")) {
+                        syscall_stats_reset();
+                        return 0;
+                }
+
+                const char *c;
+                int pid = 0;
+                for (c = argv[1]; *c; ++c) {
+                        if (*c < '0' || *c > '9') {
+                                kprintf(ksh, "sysstat: bad pid \"%s\"\n", argv[1]);
+                                return 0;
+                        }
+                        pid = pid * 10 + (*c - '0');
+                }
+                if (NULL == (p = proc_lookup(pid))) {
+                        kprintf(ksh, "sysstat: no process %d\n", pid);
+                        return 0;
+                }
+        }
+
+        if (NULL == (text = page_alloc_n(SYSCALL_STATS_TEXT_PAGES)))
+                return -ENOMEM;
+        syscall_stats_info(p, text, osize);
+        for (line = text; '\0' != *line; line = end + 1) {
+                if (NULL == (end = strchr(line, '\n')))
+                        break;
+                *end = '\0';
+                kprintf(ksh, "%s\n", line);
+        }
+        page_free_n(text, SYSCALL_STATS_TEXT_PAGES);
+        return 0;
+}
+
+void
+syscall_stats_kshell_init(void)
+{
+        kshell_add_command("sysstat", syscall_stats_cmd,
+                           "print system call counts and latency histograms");
+}
@@ -0,0 +1,327 @@
+/******************************************************************************/
+/* Important Spring 2020 CSCI 402 usage information:                          */
+/*                                                                            */
+/* This fils is part of CSCI 402 kernel programming assignments at USC.       */
+/*         53616c7465645f5fd1e93dbf35cbffa3aef28f8c01d8cf2ffc51ef62b26a       */
+/*         f9bda5a68e5ed8c972b17bab0f42e24b19daa7bd408305b1f7bd6c7208c1       */
+/*         0e36230e913039b3046dd5fd0ba706a624d33dbaa4d6aab02c82fe09f561       */
+/*         01b0fd977b0051f0b0ce0c69f7db857b1b5e007be2db6d42894bf93de848       */
+/*         806d9152bd5715e9                                                   */
+/* Please understand that you are NOT permitted to distribute or publically   */
+/*         display a copy of this file (or ANY PART of it) for any reason.    */
+/* If anyone (including your prospective employer) asks you to post the code, */
+/*         you must inform them that you do NOT have permissions to do so.    */
+/* You are also NOT permitted to remove or alter this comment block.          */
+/* If this comment block is removed or altered in a submitted file, 20 points */
+/*         will be deducted.                                                  */
+/******************************************************************************/
+
+#include "kernel.h"
+#include "globals.h"
+#include "types.h"
+#include "errno.h"
+
+#include "util/string.h"
+#include "util/debug.h"
+#include "util/list.h"
+
+#include "proc/proc.h"
+#include "proc/kthread.h"
+#include "proc/sched.h"
+
+#include "mm/mm.h"
+#include "mm/page.h"
+#include "mm/slab.h"
+#include "mm/mmobj.h"
+#include "mm/pframe.h"
+
+#include "fs/vnode.h"
+#include "fs/file.h"
+#include "fs/stat.h"
+#include "fs/fcntl.h"
+#include "fs/fdtable.h"
+#include "fs/aio.h"
+
+#include "api/access.h"
+
+/*
+ * Each request holds a reference on its file and a kernel buffer of its
+ * own, so a worker never needs the submitter's address space or file
+ * table: data to be written is copied in when the request is submitted,
+ * and data read is copied out to the user by aio_wait.
+ *
+ * Workers call the vnode's read or write directly, which for a regular
+ * file goes through the page cache. A worker that needs a page someone
+ * else is already filling (another worker, or a process faulting on a
+ * mapping of the file) sleeps on that pframe's busy wait queue in
+ * pframe_get like anyone else, so they all share one disk read. A read
+ * whose pages are all resident and not busy cannot block, so it is done
+ * at submission and never goes near the pool.
+ *
+ * Like pipes, nothing here needs a lock: the kernel is not preemptive
+ * and none of this is touched from interrupt context.
+ */
+typedef struct aio_req {
+        int             ar_id;
+        struct proc    *ar_proc;        /* NULL once the owner has exited */
+        file_t         *ar_file;
+        int             ar_write;
+        off_t           ar_off;
+        size_t          ar_len;
+        void           *ar_buf;         /* kernel copy of the data */
+        void           *ar_ubuf;
+        int             ar_res;
+        int             ar_done;
+        ktqueue_t       ar_waitq;       /* aio_wait callers */
+        list_link_t     ar_link;        /* on aio_requests while owned */
+        list_link_t     ar_qlink;       /* on aio_queue while queued */
+} aio_req_t;
+
+static slab_allocator_t *aio_allocator = NULL;
+
+static list_t aio_requests;             /* every request with an owner */
+static list_t aio_queue;                /* requests waiting for a worker */
+static ktqueue_t aio_workq;             /* idle workers */
+static int aio_next_id = 1;
+
+static proc_t *aio_workers[AIO_NWORKERS];
+static kthread_t *aio_worker_thrs[AIO_NWORKERS];
+
+static void *aio_worker_run(int arg1, void *arg2);
+
+void
+aio_init(void)
+{
+        int i;
+
+        aio_allocator = slab_allocator_create("aio", sizeof(aio_req_t));
+        KASSERT(NULL != aio_allocator);
+        list_init(&aio_requests);
+        list_init(&aio_queue);
+        sched_queue_init(&aio_workq);
+
+        KASSERT(curproc && (PID_IDLE == curproc->p_pid)
+                && "should be calling this from idleproc");
+        for (i = 0; i < AIO_NWORKERS; ++i) {
+                aio_workers[i] = proc_create("aiod");
+                KASSERT(NULL != aio_workers[i]);
+                aio_worker_thrs[i] = kthread_create(aio_workers[i], aio_worker_run, i, NULL);
+                KASSERT(NULL != aio_worker_thrs[i]);
+                sched_make_runnable(aio_worker_thrs[i]);
+        }
+}
+
+static aio_req_t *
+aio_lookup(proc_t *p, int id)
+{
+        aio_req_t *req;
+        list_iterate_begin(&aio_requests, req, aio_req_t, ar_link) {
+                if (p == req->ar_proc && id == req->ar_id)
+                        return req;
+        } list_iterate_end();
+        return NULL;
+}
+
+static int
+aio_outstanding(proc_t *p)
+{
+        aio_req_t *req;
+        int n = 0;
+        list_iterate_begin(&aio_requests, req, aio_req_t, ar_link) {
+                if (p == req->ar_proc)
+                        n++;
+        } list_iterate_end();
+        return n;
+}
+
+/* The request must be off both lists */
+static void
+aio_free(aio_req_t *req)
+{
+        KASSERT(sched_queue_empty(&req->ar_waitq));
+        fput(req->ar_file);
+        if (NULL != req->ar_buf)
+                page_free_n(req->ar_buf, PAGE_ALIGN_UP(req->ar_len) >> PAGE_SHIFT);
+        slab_obj_free(aio_allocator, req);
+}
+
+static void
+aio_run(aio_req_t *req)
+{
+        vnode_t *vn = req->ar_file->f_vnode;
+
+        if (req->ar_write)
+                req->ar_res = vn->vn_ops->write(vn, req->ar_off, req->ar_buf, req->ar_len);
+        else
+                req->ar_res = vn->vn_ops->read(vn, req->ar_off, req->ar_buf, req->ar_len);
+        req->ar_done = 1;
+
+        if (NULL == req->ar_proc)
+                aio_free(req);
+        else
+                sched_broadcast_on(&req->ar_waitq);
+}
+
+/* Nonzero if reading len bytes at off from vn will not have to wait for
+ * a page to be filled */
+static int
+aio_resident(vnode_t *vn, off_t off, size_t len)
+{
+        uint32_t pn, last;
+        pframe_t *pf;
+
+        if (!S_ISREG(vn->vn_mode))
+                return 0;
+        if (off >= vn->vn_len)
+                return 1;
+        len = MIN(len, (size_t)(vn->vn_len - off));
+        last = (off + len - 1) >> PAGE_SHIFT;
+        for (pn = off >> PAGE_SHIFT; pn <= last; ++pn) {
+                pf = pframe_get_resident(&vn->vn_mmobj, pn);
+                if (NULL == pf || pframe_is_busy(pf))
+                        return 0;
+        }
+        return 1;
+}
+
+int
+do_aio_submit(int fd, void *ubuf, size_t nbytes, off_t offset, int iswrite)
+{
+        file_t *file;
+        aio_req_t *req;
+        int err;
+
+        if (offset < 0)
+                return -EINVAL;
+        if (NULL == (file = fd_lookup(curproc, fd)))
+                return -EBADF;
+        if (S_ISDIR(file->f_vnode->vn_mode))
+                return -EISDIR;
+        /* pipes and ttys have no offset, and a read on one could hold a
+         * worker until somebody writes */
+        if (!S_ISREG(file->f_vnode->vn_mode))
+                return -ESPIPE;
+        if (!(file->f_mode & (iswrite ? FMODE_WRITE : FMODE_READ)))
+                return -EBADF;
+        if (AIO_MAX_REQUESTS <= aio_outstanding(curproc))
+                return -EAGAIN;
+
+        if (NULL == (req = (aio_req_t *)slab_obj_alloc(aio_allocator)))
+                return -ENOMEM;
+        req->ar_len = MIN(nbytes, AIO_MAX_BYTES);
+        req->ar_buf = NULL;
+        if (0 < req->ar_len
+            && NULL == (req->ar_buf = page_alloc_n(PAGE_ALIGN_UP(req->ar_len) >> PAGE_SHIFT))) {
+                slab_obj_free(aio_allocator, req);
+                return -ENOMEM;
+        }
+        if (iswrite && 0 < req->ar_len
+            && (err = copy_from_user(req->ar_buf, ubuf, req->ar_len)) < 0) {
+                page_free_n(req->ar_buf, PAGE_ALIGN_UP(req->ar_len) >> PAGE_SHIFT);
+                slab_obj_free(aio_allocator, req);
+                return err;
+        }
+
+        fref(file);
+        req->ar_file = file;
+        req->ar_proc = curproc;
+        req->ar_write = iswrite;
+        req->ar_off = offset;
+        req->ar_ubuf = ubuf;
+        req->ar_res = 0;
+        req->ar_done = 0;
+        sched_queue_init(&req->ar_waitq);
+        list_link_init(&req->ar_qlink);
+        req->ar_id = aio_next_id;
+        if (0 >= ++aio_next_id)
+                aio_next_id = 1;
+        list_insert_tail(&aio_requests, &req->ar_link);
+
+        if (0 == req->ar_len || (!iswrite && aio_resident(file->f_vnode, offset, req->ar_len))) {
+                aio_run(req);
+        } else {
+                list_insert_tail(&aio_queue, &req->ar_qlink);
+                sched_wakeup_on(&aio_workq);
+        }
+        return req->ar_id;
+}
+
+int
+do_aio_wait(int id)
+{
+        aio_req_t *req;
+        int ret;
+
+        /* look the request up again after every sleep: another thread of
+         * the process may have retired it */
+        while (1) {
+                if (NULL == (req = aio_lookup(curproc, id)))
+                        return -EINVAL;
+                if (req->ar_done)
+                        break;
+                if (sched_cancellable_sleep_on(&req->ar_waitq))
+                        return -EINTR;
+        }
+
+        ret = req->ar_res;
+        if (!req->ar_write && 0 < ret) {
+                int err = copy_to_user(req->ar_ubuf, req->ar_buf, ret);
+                if (err < 0)
+                        ret = err;
+        }
+        list_remove(&req->ar_link);
+        aio_free(req);
+        return ret;
+}
+
+void
+aio_proc_exit(proc_t *p)
+{
+        aio_req_t *req;
+        list_iterate_begin(&aio_requests, req, aio_req_t, ar_link) {
+                if (p != req->ar_proc)
+                        continue;
+                list_remove(&req->ar_link);
+                req->ar_proc = NULL;
+                if (req->ar_done)
+                        aio_free(req);
+        } list_iterate_end();
+}
+
+static void *
+aio_worker_run(int arg1, void *arg2)
+{
+        aio_req_t *req;
+
+        while (1) {
+                /* a cancelled worker keeps going until the queue is empty */
+                if (list_empty(&aio_queue)) {
+                        if (sched_cancellable_sleep_on(&aio_workq))
+                                kthread_exit((void *)0);
+                        continue;
+                }
+                req = list_head(&aio_queue, aio_req_t, ar_qlink);
+                list_remove(&req->ar_qlink);
+                aio_run(req);
+        }
+        return NULL;
+}
+
+void
+aio_shutdown(void)
+{
+        int i, pid, child;
+
+        for (i = 0; i < AIO_NWORKERS; ++i) {
+                KASSERT(curproc == aio_workers[i]->p_pproc);
+                kthread_cancel(aio_worker_thrs[i], (void *)0);
+        }
+        for (i = 0; i < AIO_NWORKERS; ++i) {
+                pid = aio_workers[i]->p_pid;
+                child = do_waitpid(pid, 0, NULL);
+                KASSERT(pid == child && "waited on process other than aiod");
+                aio_workers[i] = NULL;
+                aio_worker_thrs[i] = NULL;
+        }
+        KASSERT(list_empty(&aio_queue));
+}
@@ -0,0 +1,212 @@
+/******************************************************************************/
+/* Important Spring 2020 CSCI 402 usage information:                          */
+/*                                                                            */
+/* This fils is part of CSCI 402 kernel programming assignments at USC.       */
+/*         53616c7465645f5fd1e93dbf35cbffa3aef28f8c01d8cf2ffc51ef62b26a       */
+/*         f9bda5a68e5ed8c972b17bab0f42e24b19daa7bd408305b1f7bd6c7208c1       */
+/*         0e36230e913039b3046dd5fd0ba706a624d33dbaa4d6aab02c82fe09f561       */
+/*         01b0fd977b0051f0b0ce0c69f7db857b1b5e007be2db6d42894bf93de848       */
+/*         806d9152bd5715e9                                                   */
+/* Please understand that you are NOT permitted to distribute or publically   */
+/*         display a copy of this file (or ANY PART of it) for any reason.    */
+/* If anyone (including your prospective employer) asks you to post the code, */
+/*         you must inform them that you do NOT have permissions to do so.    */
+/* You are also NOT permitted to remove or alter this comment block.          */
+/* If this comment block is removed or altered in a submitted file, 20 points */
+/*         will be deducted.                                                  */
+/******************************************************************************/
+
+#include "kernel.h"
+#include "globals.h"
+#include "types.h"
+#include "errno.h"
+
+#include "util/init.h"
+#include "util/string.h"
+#include "util/debug.h"
+#include "util/list.h"
+
+#include "mm/slab.h"
+
+#include "fs/dirent.h"
+#include "fs/vfs.h"
+#include "fs/vnode.h"
+#include "fs/dcache.h"
+
+#include "test/kshell/kshell.h"
+
+/*
+ * Entries are keyed on the directory's (fs, vno) rather than its vnode
+ * pointer, since the vnode may be freed and its memory reused while its
+ * entries are still cached. At most DCACHE_MAX entries are kept; the least
+ * recently used one is recycled when a new one is needed.
+ */
+#define DCACHE_MAX      512
+#define DCACHE_NBUCKETS 256
+
+typedef struct dentry {
+        struct fs      *de_dirfs;
+        ino_t           de_dirvno;
+        char            de_name[NAME_LEN];
+        size_t          de_len;
+        struct fs      *de_fs;          /* where the name leads; NULL if it */
+        ino_t           de_vno;         /* does not exist */
+        list_link_t     de_hlink;       /* link on dcache_hash bucket */
+        list_link_t     de_lrulink;     /* link on dcache_lru */
+} dentry_t;
+
+static slab_allocator_t *dentry_allocator = NULL;
+static list_t dcache_hash[DCACHE_NBUCKETS];
+static list_t dcache_lru;       /* least recently used first */
+static int dcache_count = 0;
+
+static uint32_t dcache_hits = 0;
+static uint32_t dcache_neg_hits = 0;
+static uint32_t dcache_misses = 0;
+
+static uint32_t
+dcache_hashfn(struct fs *fs, ino_t vno, const char *name, size_t len)
+{
+        uint32_t h = (((uint32_t)fs) >> 4) ^ ((uint32_t)vno * 2654435761u);
+        size_t i;
+        for (i = 0; i < len; ++i)
+                h = h * 31 + (unsigned char)name[i];
+        return h % DCACHE_NBUCKETS;
+}
+
+static __attribute__((unused)) void
+dcache_init(void)
+{
+        int i;
+        for (i = 0; i < DCACHE_NBUCKETS; ++i)
+                list_init(&dcache_hash[i]);
+        list_init(&dcache_lru);
+        dentry_allocator = slab_allocator_create("dentry", sizeof(dentry_t));
+        KASSERT(NULL != dentry_allocator);
+}
+init_func(dcache_init);
+
+static dentry_t *
+dcache_find(vnode_t *dir, const char *name, size_t len)
+{
+        dentry_t *de;
+        list_t *bucket = &dcache_hash[dcache_hashfn(dir->vn_fs, dir->vn_vno, name, len)];
+
+        list_iterate_begin(bucket, de, dentry_t, de_hlink) {
+                if (de->de_dirfs == dir->vn_fs && de->de_dirvno == dir->vn_vno
+                    && de->de_len == len && !strncmp(de->de_name, name, len))
+                        return de;
+        } list_iterate_end();
+        return NULL;
+}
+
+static void
+dcache_free(dentry_t *de)
+{
+        list_remove(&de->de_hlink);
+        list_remove(&de->de_lrulink);
+        dcache_count--;
+        slab_obj_free(dentry_allocator, de);
+}
+
+int
+dcache_lookup(vnode_t *dir, const char *name, size_t len, vnode_t **result)
+{
+        dentry_t *de = dcache_find(dir, name, len);
+        if (NULL == de) {
+                dcache_misses++;
+                return DCACHE_MISS;
+        }
+
+        list_remove(&de->de_lrulink);
+        list_insert_tail(&dcache_lru, &de->de_lrulink);
+        if (NULL == de->de_fs) {
+                dcache_neg_hits++;
+                return -ENOENT;
+        }
+        dcache_hits++;
+        *result = vget(de->de_fs, de->de_vno);
+        return 0;
+}
+
+void
+dcache_enter(vnode_t *dir, const char *name, size_t len, vnode_t *vn)
+{
+        dentry_t *de;
+
+        if (len > NAME_LEN || NULL != dcache_find(dir, name, len))
+                return;
+
+        if (dcache_count >= DCACHE_MAX) {
+                de = list_head(&dcache_lru, dentry_t, de_lrulink);
+                dcache_free(de);
+        }
+        if (NULL == (de = slab_obj_alloc(dentry_allocator)))
+                return;
+
+        de->de_dirfs = dir->vn_fs;
+        de->de_dirvno = dir->vn_vno;
+        memcpy(de->de_name, name, len);
+        de->de_len = len;
+        de->de_fs = (NULL == vn) ? NULL : vn->vn_fs;
+        de->de_vno = (NULL == vn) ? 0 : vn->vn_vno;
+        list_insert_head(&dcache_hash[dcache_hashfn(dir->vn_fs, dir->vn_vno, name, len)],
+                         &de->de_hlink);
+        list_insert_tail(&dcache_lru, &de->de_lrulink);
+        dcache_count++;
+}
+
+void
+dcache_remove(vnode_t *dir, const char *name, size_t len)
+{
+        dentry_t *de = dcache_find(dir, name, len);
+        if (NULL != de)
+                dcache_free(de);
+}
+
+void
+dcache_purge_dir(vnode_t *dir)
+{
+        dentry_t *de;
+        list_iterate_begin(&dcache_lru, de, dentry_t, de_lrulink) {
+                if (de->de_dirfs == dir->vn_fs && de->de_dirvno == dir->vn_vno)
+                        dcache_free(de);
+        } list_iterate_end();
+}
+
+void
+dcache_purge_fs(struct fs *fs)
+{
+        dentry_t *de;
+        list_iterate_begin(&dcache_lru, de, dentry_t, de_lrulink) {
+                if (de->de_dirfs == fs || de->de_fs == fs)
+                        dcache_free(de);
+        } list_iterate_end();
+}
+
+/* Percentage of a out of a + b, to one decimal place */
+static void
+dcache_print_rate(kshell_t *ksh, const char *what, uint32_t a, uint32_t b)
+{
+        uint32_t permille = (0 == a + b) ? 0 : (uint32_t)(((uint64_t)a * 1000) / (a + b));
+        kprintf(ksh, "%-14s %10u (%u.%u%%)\n", what, a, permille / 10, permille % 10);
+}
+
+static int
+dcache_cmd(kshell_t *ksh, int argc, char **argv)
+{
+        uint32_t lookups = dcache_hits + dcache_neg_hits + dcache_misses;
+
+        kprintf(ksh, "%-14s %10d of %d\n", "entries", dcache_count, DCACHE_MAX);
+        kprintf(ksh, "%-14s %10u\n", "lookups", lookups);
+        dcache_print_rate(ksh, "hits", dcache_hits, dcache_neg_hits + dcache_misses);
+        dcache_print_rate(ksh, "negative hits", dcache_neg_hits, dcache_hits + dcache_misses);
+        dcache_print_rate(ksh, "misses", dcache_misses, dcache_hits + dcache_neg_hits);
+        return 0;
+}
+
+void
+dcache_kshell_init(void)
+{
+        kshell_add_command("dcache", dcache_cmd, "print dentry cache hit rates");
+}
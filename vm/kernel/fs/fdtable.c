@@ -0,0 +1,282 @@
+/******************************************************************************/
+/* Important Spring 2020 CSCI 402 usage information:                          */
+/*                                                                            */
+/* This fils is part of CSCI 402 kernel programming assignments at USC.       */
+/*         53616c7465645f5fd1e93dbf35cbffa3aef28f8c01d8cf2ffc51ef62b26a       */
+/*         f9bda5a68e5ed8c972b17bab0f42e24b19daa7bd408305b1f7bd6c7208c1       */
+/*         0e36230e913039b3046dd5fd0ba706a624d33dbaa4d6aab02c82fe09f561       */
+/*         01b0fd977b0051f0b0ce0c69f7db857b1b5e007be2db6d42894bf93de848       */
+/*         806d9152bd5715e9                                                   */
+/* Please understand that you are NOT permitted to distribute or publically   */
+/*         display a copy of this file (or ANY PART of it) for any reason.    */
+/* If anyone (including your prospective employer) asks you to post the code, */
+/*         you must inform them that you do NOT have permissions to do so.    */
+/* You are also NOT permitted to remove or alter this comment block.          */
+/* If this comment block is removed or altered in a submitted file, 20 points */
+/*         will be deducted.                                                  */
+/******************************************************************************/
+
+#include "kernel.h"
+#include "globals.h"
+#include "types.h"
+#include "errno.h"
+
+#include "util/string.h"
+#include "util/debug.h"
+
+#include "proc/proc.h"
+
+#include "mm/slab.h"
+#include "mm/kmalloc.h"
+
+#include "fs/file.h"
+#include "fs/fdtable.h"
+
+#define FDT_WORD(fd)    ((fd) >> 5)
+#define FDT_BIT(fd)     (1u << ((fd) & 31))
+#define FDT_WORDS(n)    (((n) + 31) >> 5)
+
+/* Index of the lowest clear bit of w, which must not be all ones */
+#define FDT_FFZ(w)      __builtin_ctz(~(w))
+
+static slab_allocator_t *fdtable_allocator = NULL;
+
+/* Called from kmain before the first process is created, so this cannot
+ * be an init_func */
+void
+fdtable_init(void)
+{
+        fdtable_allocator = slab_allocator_create("fdtable", sizeof(fdtable_t));
+        KASSERT(NULL != fdtable_allocator);
+}
+
+/* Gives fdt new arrays with room for size descriptors, carrying over
+ * what is in the old ones (which are freed) */
+static int
+fdtable_resize(fdtable_t *fdt, int size)
+{
+        struct file **files;
+        uint32_t *open, *full;
+        int oldsize = fdt->fdt_size;
+
+        KASSERT(0 == (size & 31) && size <= FDTABLE_MAX && size > oldsize);
+        files = kmalloc(size * sizeof(*files));
+        open = kmalloc(FDT_WORDS(size) * sizeof(*open));
+        full = kmalloc(FDT_WORDS(FDT_WORDS(size)) * sizeof(*full));
+        if (NULL == files || NULL == open || NULL == full) {
+                if (files)
+                        kfree(files);
+                if (open)
+                        kfree(open);
+                if (full)
+                        kfree(full);
+                return -ENOMEM;
+        }
+
+        memset(files, 0, size * sizeof(*files));
+        memset(open, 0, FDT_WORDS(size) * sizeof(*open));
+        memset(full, 0, FDT_WORDS(FDT_WORDS(size)) * sizeof(*full));
+        if (oldsize) {
+                memcpy(files, fdt->fdt_files, oldsize * sizeof(*files));
+                memcpy(open, fdt->fdt_open, FDT_WORDS(oldsize) * sizeof(*open));
+                memcpy(full, fdt->fdt_full, FDT_WORDS(FDT_WORDS(oldsize)) * sizeof(*full));
+                kfree(fdt->fdt_files);
+                kfree(fdt->fdt_open);
+                kfree(fdt->fdt_full);
+        }
+        fdt->fdt_files = files;
+        fdt->fdt_open = open;
+        fdt->fdt_full = full;
+        fdt->fdt_size = size;
+        return 0;
+}
+
+fdtable_t *
+fdtable_create(void)
+{
+        fdtable_t *fdt = slab_obj_alloc(fdtable_allocator);
+        if (NULL == fdt)
+                return NULL;
+        fdt->fdt_refcount = 1;
+        fdt->fdt_size = 0;
+        fdt->fdt_count = 0;
+        if (fdtable_resize(fdt, FDTABLE_MIN) < 0) {
+                slab_obj_free(fdtable_allocator, fdt);
+                return NULL;
+        }
+        return fdt;
+}
+
+fdtable_t *
+fdtable_share(fdtable_t *fdt)
+{
+        KASSERT(0 < fdt->fdt_refcount);
+        fdt->fdt_refcount++;
+        return fdt;
+}
+
+void
+fdtable_put(fdtable_t *fdt)
+{
+        KASSERT(0 < fdt->fdt_refcount);
+        if (0 < --fdt->fdt_refcount)
+                return;
+        KASSERT(0 == fdt->fdt_count);
+        kfree(fdt->fdt_files);
+        kfree(fdt->fdt_open);
+        kfree(fdt->fdt_full);
+        slab_obj_free(fdtable_allocator, fdt);
+}
+
+/* The next descriptor in use at or after fd, or -1 */
+static int
+fdtable_next(fdtable_t *fdt, int fd)
+{
+        int w;
+        uint32_t bits;
+
+        if (fd < 0 || fd >= fdt->fdt_size)
+                return -1;
+        w = FDT_WORD(fd);
+        bits = fdt->fdt_open[w] & ~(FDT_BIT(fd) - 1);
+        while (0 == bits) {
+                if (++w >= FDT_WORDS(fdt->fdt_size))
+                        return -1;
+                bits = fdt->fdt_open[w];
+        }
+        return (w << 5) + __builtin_ctz(bits);
+}
+
+/* Returns a copy of fdt with a reference on every open file, or NULL if
+ * out of memory. Only the descriptors in use are visited. */
+static fdtable_t *
+fdtable_dup(fdtable_t *fdt)
+{
+        fdtable_t *new = slab_obj_alloc(fdtable_allocator);
+        int fd;
+
+        if (NULL == new)
+                return NULL;
+        new->fdt_refcount = 1;
+        new->fdt_size = 0;
+        new->fdt_count = 0;
+        if (fdtable_resize(new, fdt->fdt_size) < 0) {
+                slab_obj_free(fdtable_allocator, new);
+                return NULL;
+        }
+
+        memcpy(new->fdt_open, fdt->fdt_open, FDT_WORDS(fdt->fdt_size) * sizeof(uint32_t));
+        memcpy(new->fdt_full, fdt->fdt_full, FDT_WORDS(FDT_WORDS(fdt->fdt_size)) * sizeof(uint32_t));
+        for (fd = fdtable_next(fdt, 0); fd >= 0; fd = fdtable_next(fdt, fd + 1)) {
+                new->fdt_files[fd] = fdt->fdt_files[fd];
+                fref(new->fdt_files[fd]);
+        }
+        new->fdt_count = fdt->fdt_count;
+        return new;
+}
+
+/* p's table, created first if p has none and copied first if another
+ * process shares it, or NULL if out of memory */
+static fdtable_t *
+fdtable_writable(proc_t *p)
+{
+        fdtable_t *fdt = *proc_fdtable(p);
+        fdtable_t *copy;
+
+        if (NULL == fdt)
+                return *proc_fdtable(p) = fdtable_create();
+        if (!fdtable_shared(fdt))
+                return fdt;
+        if (NULL == (copy = fdtable_dup(fdt)))
+                return NULL;
+        fdtable_put(fdt);
+        *proc_fdtable(p) = copy;
+        return copy;
+}
+
+struct file *
+fd_lookup(proc_t *p, int fd)
+{
+        fdtable_t *fdt = *proc_fdtable(p);
+        if (NULL == fdt || fd < 0 || fd >= fdt->fdt_size)
+                return NULL;
+        return fdt->fdt_files[fd];
+}
+
+int
+fd_lowest_free(proc_t *p)
+{
+        fdtable_t *fdt = *proc_fdtable(p);
+        int i, w;
+
+        if (NULL == fdt)
+                return 0;
+        for (i = 0; i < FDT_WORDS(FDT_WORDS(fdt->fdt_size)); ++i) {
+                if (~0u == fdt->fdt_full[i])
+                        continue;
+                w = (i << 5) + FDT_FFZ(fdt->fdt_full[i]);
+                if (w >= FDT_WORDS(fdt->fdt_size))
+                        break;
+                return (w << 5) + FDT_FFZ(fdt->fdt_open[w]);
+        }
+        /* the table is full; the next one goes past its end */
+        if (fdt->fdt_size >= FDTABLE_MAX) {
+                dbg(DBG_ERROR | DBG_VFS, "ERROR: out of file descriptors "
+                    "for pid %d\n", p->p_pid);
+                return -EMFILE;
+        }
+        return fdt->fdt_size;
+}
+
+int
+fd_install(proc_t *p, int fd, struct file *file)
+{
+        fdtable_t *fdt;
+        int size, err, w;
+
+        if (fd < 0 || fd >= FDTABLE_MAX)
+                return -EBADF;
+        if (NULL == (fdt = fdtable_writable(p)))
+                return -ENOMEM;
+        if (fd >= fdt->fdt_size) {
+                for (size = fdt->fdt_size * 2; size <= fd; size *= 2)
+                        ;
+                if ((err = fdtable_resize(fdt, MIN(size, FDTABLE_MAX))) < 0)
+                        return err;
+        }
+
+        KASSERT(NULL == fdt->fdt_files[fd]);
+        fdt->fdt_files[fd] = file;
+        w = FDT_WORD(fd);
+        fdt->fdt_open[w] |= FDT_BIT(fd);
+        if (~0u == fdt->fdt_open[w])
+                fdt->fdt_full[FDT_WORD(w)] |= FDT_BIT(w);
+        fdt->fdt_count++;
+        return 0;
+}
+
+int
+fd_remove(proc_t *p, int fd, struct file **filep)
+{
+        fdtable_t *fdt;
+        int w;
+
+        if (NULL == fd_lookup(p, fd))
+                return -EBADF;
+        if (NULL == (fdt = fdtable_writable(p)))
+                return -ENOMEM;
+        *filep = fdt->fdt_files[fd];
+        fdt->fdt_files[fd] = NULL;
+        w = FDT_WORD(fd);
+        fdt->fdt_open[w] &= ~FDT_BIT(fd);
+        fdt->fdt_full[FDT_WORD(w)] &= ~FDT_BIT(w);
+        fdt->fdt_count--;
+        return 0;
+}
+
+int
+fd_next(proc_t *p, int fd)
+{
+        fdtable_t *fdt = *proc_fdtable(p);
+        return NULL == fdt ? -1 : fdtable_next(fdt, fd);
+}
@@ -21,15 +21,62 @@
 #include "types.h"
 #include "errno.h"
 
+#include "util/init.h"
 #include "util/string.h"
 #include "util/printf.h"
 #include "util/debug.h"
+#include "util/trace.h"
+
+#include "proc/krwlock.h"
 
 #include "fs/dirent.h"
 #include "fs/fcntl.h"
 #include "fs/stat.h"
 #include "fs/vfs.h"
 #include "fs/vnode.h"
+#include "fs/dirlock.h"
+#include "fs/dcache.h"
+
+/* Directory locks. vnode_t has no lock of this kind, so directories share
+ * a small array of reader-writer locks picked by hashing the vnode's
+ * address (the same trick pframe_hash uses for resident pages). */
+#define VNODE_DIR_NLOCKS 32
+#define vnode_dir_lock_of(dir) \
+        (&vnode_dir_locks[(((uint32_t)(dir)) >> 4) % VNODE_DIR_NLOCKS])
+static krwlock_t vnode_dir_locks[VNODE_DIR_NLOCKS];
+
+static __attribute__((unused)) void
+vnode_dir_lock_init(void)
+{
+        int i;
+        for (i = 0; i < VNODE_DIR_NLOCKS; ++i)
+                krwlock_init(&vnode_dir_locks[i]);
+}
+init_func(vnode_dir_lock_init);
+
+void
+vnode_dir_rdlock(vnode_t *dir)
+{
+        krwlock_rdlock(vnode_dir_lock_of(dir));
+}
+
+void
+vnode_dir_rdunlock(vnode_t *dir)
+{
+        krwlock_rdunlock(vnode_dir_lock_of(dir));
+}
+
+void
+vnode_dir_wrlock(vnode_t *dir)
+{
+        krwlock_wrlock(vnode_dir_lock_of(dir));
+}
+
+void
+vnode_dir_wrunlock(vnode_t *dir)
+{
+        krwlock_wrunlock(vnode_dir_lock_of(dir));
+}
 
 /* This takes a base 'dir', a 'name', its 'len', and a result vnode.
  * Most of the work should be done by the vnode's implementation
@@ -45,27 +92,36 @@ lookup(vnode_t *dir, const char *name, size_t len, vnode_t **result)
         KASSERT(NULL != dir); /* the "dir" argument must be non-NULL */
         KASSERT(NULL != name); /* the "name" argument must be non-NULL */
         KASSERT(NULL != result); /* the "result" argument must be non-NULL */
-        dbg(DBG_PRINT, "(GRADING2A 2.a)\n");
+        grading_dbg("(GRADING2A 2.a)\n");
 
         if (NULL == dir->vn_ops->lookup) {
-                dbg(DBG_PRINT, "(GRADING2B)\n");
+                grading_dbg("(GRADING2B)\n");
                 return -ENOTDIR;
         }
         if (0 == len) {
                 *result = dir;
                 vref(dir);
-                dbg(DBG_PRINT, "(GRADING2B)\n");
+                grading_dbg("(GRADING2B)\n");
                 return 0;
         }
         if (len > STR_MAX) {
-                dbg(DBG_PRINT, "(GRADING2B)\n");
+                grading_dbg("(GRADING2B)\n");
                 return -ENAMETOOLONG;
         }
-        int val = dir->vn_ops->lookup(dir, name, len, result);
+        vnode_dir_rdlock(dir);
+        int val = dcache_lookup(dir, name, len, result);
+        if (DCACHE_MISS == val) {
+                val = dir->vn_ops->lookup(dir, name, len, result);
+                if (0 == val)
+                        dcache_enter(dir, name, len, *result);
+                else if (-ENOENT == val)
+                        dcache_enter(dir, name, len, NULL);
+        }
+        vnode_dir_rdunlock(dir);
         /*if (0 == val) {
                 vref(*result);
         }*/
-        dbg(DBG_PRINT, "(GRADING2A)\n");
+        grading_dbg("(GRADING2A)\n");
         return val;
 }
 
@@ -87,6 +143,10 @@ lookup(vnode_t *dir, const char *name, size_t len, vnode_t **result)
  *
  * Note: A successful call to this causes vnode refcount on *res_vnode to
  * be incremented.
+ *
+ * Only one reference is held at any time during the walk: the one on the
+ * directory being searched, which is handed over to the next component
+ * as soon as lookup() has returned it.
  */
 int
 dir_namev(const char *pathname, size_t *namelen, const char **name,
@@ -96,16 +156,15 @@ dir_namev(const char *pathname, size_t *namelen, const char **name,
         KASSERT(NULL != namelen); /* the "namelen" argument must be non-NULL */
         KASSERT(NULL != name); /* the "name" argument must be non-NULL */
         KASSERT(NULL != res_vnode); /* the "res_vnode" argument must be non-NULL */
-        dbg(DBG_PRINT, "(GRADING2A 2.b)\n");
+        grading_dbg("(GRADING2A 2.b)\n");
 
         vnode_t *dir_vnode = pathname[0] == '/' ? vfs_root_vn : (NULL == base ? curproc->p_cwd : base);
+        vnode_t *next_vnode;
         vref(dir_vnode);
-        vnode_t *target_vnode = dir_vnode;
-        vref(target_vnode);
         int i = 0;
         while (pathname[i] == '/') {
                 i++;
-                dbg(DBG_PRINT, "(GRADING2A)\n");
+                grading_dbg("(GRADING2A)\n");
         }
         int last = i;
         int len = 0;
@@ -115,37 +174,33 @@ dir_namev(const char *pathname, size_t *namelen, const char **name,
                 last = i;
                 while (pathname[i] != '/' && pathname[i] != '\0') {
                         i++;
-                        dbg(DBG_PRINT, "(GRADING2A)\n");
+                        grading_dbg("(GRADING2A)\n");
                 }
                 len = i - last;
                 if (pathname[i] == '\0') {
-                        dbg(DBG_PRINT, "(GRADING2A)\n");
+                        grading_dbg("(GRADING2A)\n");
                         break;
                 }
                 while (pathname[i] == '/') {
                         i++;
-                        dbg(DBG_PRINT, "(GRADING2A)\n");
+                        grading_dbg("(GRADING2A)\n");
                 }
                 KASSERT(NULL != dir_vnode); /* pathname resolution must start with a valid directory */
-                dbg(DBG_PRINT, "(GRADING2A 2.b)\n");
+                grading_dbg("(GRADING2A 2.b)\n");
 
-                vput(target_vnode);
-                val = lookup(dir_vnode, &pathname[last], len, &target_vnode);
+                val = lookup(dir_vnode, &pathname[last], len, &next_vnode);
+                vput(dir_vnode);
                 if (val < 0) {
-                        vput(dir_vnode);
-                        dbg(DBG_PRINT, "(GRADING2B)\n");
+                        grading_dbg("(GRADING2B)\n");
                         return val;
                 }
-                vput(dir_vnode);
-                dir_vnode = target_vnode;
-                vref(dir_vnode);
-                dbg(DBG_PRINT, "(GRADING2A)\n");
+                dir_vnode = next_vnode;
+                grading_dbg("(GRADING2A)\n");
         }
         *namelen = len;
         *name = &pathname[last];
         *res_vnode = dir_vnode;
-        vput(target_vnode);
-        dbg(DBG_PRINT, "(GRADING2A)\n");
+        grading_dbg("(GRADING2A)\n");
         return val;
 }
 
@@ -168,7 +223,7 @@ open_namev(const char *pathname, int flag, vnode_t **res_vnode, vnode_t *base)
         vnode_t *dir;
         int val = dir_namev(pathname, &namelen, (const char **)&name, base, &dir);
         if (val < 0) {
-                dbg(DBG_PRINT, "(GRADING2B)\n");
+                grading_dbg("(GRADING2B)\n");
                 return val;
         }
 
@@ -177,16 +232,19 @@ open_namev(const char *pathname, int flag, vnode_t **res_vnode, vnode_t *base)
         if ((flag & O_CREAT) && val == -ENOENT) { 
                 /* if file does not exist inside dir_vnode, need to make sure you can create the file */
                 KASSERT(NULL != dir->vn_ops->create);
-                dbg(DBG_PRINT, "(GRADING2A 2.c)\n");
-                dbg(DBG_PRINT, "(GRADING2B)\n");
+                grading_dbg("(GRADING2A 2.c)\n");
+                grading_dbg("(GRADING2B)\n");
                 // ???
                 /* please use TWO consecutive "conforming dbg() calls" for this since this function is not executed if you just start and stop weenix */
+                vnode_dir_wrlock(dir);
+                dcache_remove(dir, name, namelen);
                 val = dir->vn_ops->create(dir, name, namelen, res_vnode);
+                vnode_dir_wrunlock(dir);
                 // ??? need to call vref(res_vnode)
-                dbg(DBG_PRINT, "(GRADING2B)\n");
+                grading_dbg("(GRADING2B)\n");
         }
         vput(dir);
-        dbg(DBG_PRINT, "(GRADING2A)\n");
+        grading_dbg("(GRADING2A)\n");
         return val;
 }
 
@@ -34,22 +34,15 @@
 #include "fs/vfs_syscall.h"
 #include "fs/open.h"
 #include "fs/stat.h"
+#include "fs/fdtable.h"
 #include "util/debug.h"
+#include "util/trace.h"
 
-/* find empty index in p->p_files[] */
+/* find the lowest unused descriptor of p (see fs/fdtable.c) */
 int
 get_empty_fd(proc_t *p)
 {
-        int fd;
-
-        for (fd = 0; fd < NFILES; fd++) {
-                if (!p->p_files[fd])
-                        return fd;
-        }
-
-        dbg(DBG_ERROR | DBG_VFS, "ERROR: get_empty_fd: out of file descriptors "
-            "for pid %d\n", curproc->p_pid);
-        return -EMFILE;
+        return fd_lowest_free(p);
 }
 
 /*
@@ -92,12 +85,12 @@ int
 do_open(const char *filename, int oflags)
 {
         if ((oflags & ~0x703) || ((oflags & 0x003) == 3)) {
-                dbg(DBG_PRINT, "(GRADING2B)\n");
+                grading_dbg("(GRADING2B)\n");
                 return -EINVAL;
         }
         int fd = get_empty_fd(curproc);
         if (fd < 0) {
-                dbg(DBG_PRINT, "(GRADING2D)\n");
+                grading_dbg("(GRADING2D)\n");
                 return -EMFILE;
         }
         file_t *file = fget(-1);
@@ -108,41 +101,44 @@ do_open(const char *filename, int oflags)
         int flag = oflags & 0x003;
         if (O_RDONLY == flag) {
                 flag = FMODE_READ;
-                dbg(DBG_PRINT, "(GRADING2B)\n");
+                grading_dbg("(GRADING2B)\n");
         } else if (O_WRONLY == flag) {
                 flag = FMODE_WRITE;
-                dbg(DBG_PRINT, "(GRADING2B)\n");
+                grading_dbg("(GRADING2B)\n");
         } else {
                 flag = FMODE_READ | FMODE_WRITE;
-                dbg(DBG_PRINT, "(GRADING2A)\n");
+                grading_dbg("(GRADING2A)\n");
         }
         if (oflags & 0x400) {
                 flag = flag | FMODE_APPEND;
-                dbg(DBG_PRINT, "(GRADING2B)\n");
+                grading_dbg("(GRADING2B)\n");
         }
         file->f_mode = flag;
         vnode_t *res_vnode;
         int val = open_namev(filename, oflags, &res_vnode, NULL);
         if (val < 0) {
                 fput(file);
-                dbg(DBG_PRINT, "(GRADING2B)\n");
+                grading_dbg("(GRADING2B)\n");
                 return val;
         }
         if (S_ISDIR(res_vnode->vn_mode) && flag&FMODE_WRITE) {
                 fput(file);
                 vput(res_vnode);
-                dbg(DBG_PRINT, "(GRADING2B)\n");
+                grading_dbg("(GRADING2B)\n");
                 return -EISDIR;
         }
         if ((S_ISCHR(res_vnode->vn_mode) && NULL == res_vnode->vn_cdev) || 
             (S_ISBLK(res_vnode->vn_mode) && NULL == res_vnode->vn_bdev)) {
                 fput(file);
                 vput(res_vnode);
-                dbg(DBG_PRINT, "(GRADING2D)\n");
+                grading_dbg("(GRADING2D)\n");
                 return -ENXIO;
         }
         file->f_vnode = res_vnode;
-        curproc->p_files[fd] = file;
-        dbg(DBG_PRINT, "(GRADING2A)\n");
+        if ((val = fd_install(curproc, fd, file)) < 0) {
+                fput(file);
+                return val;
+        }
+        grading_dbg("(GRADING2A)\n");
         return fd;
 }
@@ -0,0 +1,639 @@
+/******************************************************************************/
+/* Important Spring 2020 CSCI 402 usage information:                          */
+/*                                                                            */
+/* This fils is part of CSCI 402 kernel programming assignments at USC.       */
+/*         53616c7465645f5fd1e93dbf35cbffa3aef28f8c01d8cf2ffc51ef62b26a       */
+/*         f9bda5a68e5ed8c972b17bab0f42e24b19daa7bd408305b1f7bd6c7208c1       */
+/*         0e36230e913039b3046dd5fd0ba706a624d33dbaa4d6aab02c82fe09f561       */
+/*         01b0fd977b0051f0b0ce0c69f7db857b1b5e007be2db6d42894bf93de848       */
+/*         806d9152bd5715e9                                                   */
+/* Please understand that you are NOT permitted to distribute or publically   */
+/*         display a copy of this file (or ANY PART of it) for any reason.    */
+/* If anyone (including your prospective employer) asks you to post the code, */
+/*         you must inform them that you do NOT have permissions to do so.    */
+/* You are also NOT permitted to remove or alter this comment block.          */
+/* If this comment block is removed or altered in a submitted file, 20 points */
+/*         will be deducted.                                                  */
+/******************************************************************************/
+
+#include "kernel.h"
+#include "globals.h"
+#include "types.h"
+#include "errno.h"
+
+#include "util/init.h"
+#include "util/string.h"
+#include "util/debug.h"
+#include "util/list.h"
+
+#include "mm/page.h"
+#include "mm/pframe.h"
+#include "mm/slab.h"
+#include "mm/kmalloc.h"
+
+#include "fs/dirent.h"
+#include "fs/vfs.h"
+#include "fs/vnode.h"
+#include "fs/stat.h"
+#include "fs/tmpfs.h"
+
+/*
+ * Each file or directory is a tmpfs_inode_t, found by number in the
+ * per-fs inode table. Inodes outlive their vnodes: a vnode is only a view
+ * of an inode, and the inode goes away when its last name is removed and
+ * its vnode is deleted.
+ *
+ * A regular file's contents are the pages of its vnode's mmobj. Like
+ * anonymous memory they have nowhere to be written back to, so fillpage
+ * zero-fills and pins each page; the pins (and the references the pages
+ * hold on the vnode) keep the data in memory until the file is unlinked
+ * and closed or the fs is unmounted, at which point vnode.c drops them.
+ *
+ * Directory entries of every directory live in one per-fs hash table keyed
+ * on (directory, name). Each directory also keeps its entries on a list
+ * in the order they were added, for readdir. "." and ".." are not stored.
+ */
+#define TMPFS_INODE_BUCKETS     64
+#define TMPFS_DIRENT_BUCKETS    256
+
+/* readdir cookies of "." and ".."; stored entries start after them */
+#define TMPFS_OFF_DOT           0
+#define TMPFS_OFF_DOTDOT        1
+#define TMPFS_OFF_FIRST         2
+
+typedef struct tmpfs_inode {
+        ino_t           ti_ino;
+        int             ti_mode;
+        int             ti_nlink;       /* names referring to this inode */
+        devid_t         ti_devid;
+        off_t           ti_len;         /* size of a file, entries in a dir */
+        ino_t           ti_parent;      /* directories only */
+        list_t          ti_dirents;     /* directories only, readdir order */
+        off_t           ti_nextoff;     /* cookie for the next entry added */
+        list_link_t     ti_link;        /* link on tf_inodes bucket */
+} tmpfs_inode_t;
+
+typedef struct tmpfs_dirent {
+        ino_t           td_dir;
+        ino_t           td_ino;
+        off_t           td_off;         /* readdir cookie */
+        size_t          td_len;
+        char            td_name[NAME_LEN];
+        list_link_t     td_hlink;       /* link on tf_dirents bucket */
+        list_link_t     td_dlink;       /* link on the directory's ti_dirents */
+} tmpfs_dirent_t;
+
+typedef struct tmpfs {
+        ino_t           tf_nextino;
+        list_t          tf_inodes[TMPFS_INODE_BUCKETS];
+        list_t          tf_dirents[TMPFS_DIRENT_BUCKETS];
+} tmpfs_t;
+
+#define VNODE_TO_TMPFS(vn)      ((tmpfs_t *)(vn)->vn_fs->fs_i)
+#define VNODE_TO_INODE(vn)      ((tmpfs_inode_t *)(vn)->vn_i)
+
+static void tmpfs_read_vnode(vnode_t *vn);
+static void tmpfs_delete_vnode(vnode_t *vn);
+static int tmpfs_query_vnode(vnode_t *vn);
+static int tmpfs_umount(fs_t *fs);
+
+static int tmpfs_read(vnode_t *file, off_t offset, void *buf, size_t count);
+static int tmpfs_write(vnode_t *file, off_t offset, const void *buf, size_t count);
+static int tmpfs_mmap(vnode_t *file, vmarea_t *vma, mmobj_t **ret);
+static int tmpfs_create(vnode_t *dir, const char *name, size_t name_len, vnode_t **result);
+static int tmpfs_mknod(vnode_t *dir, const char *name, size_t name_len, int mode, devid_t devid);
+static int tmpfs_lookup(vnode_t *dir, const char *name, size_t name_len, vnode_t **result);
+static int tmpfs_link(vnode_t *oldvnode, vnode_t *dir, const char *name, size_t name_len);
+static int tmpfs_unlink(vnode_t *dir, const char *name, size_t name_len);
+static int tmpfs_mkdir(vnode_t *dir, const char *name, size_t name_len);
+static int tmpfs_rmdir(vnode_t *dir, const char *name, size_t name_len);
+static int tmpfs_readdir(vnode_t *dir, off_t offset, struct dirent *d);
+static int tmpfs_stat(vnode_t *vn, struct stat *ss);
+static int tmpfs_fillpage(vnode_t *vn, off_t offset, void *pagebuf);
+static int tmpfs_dirtypage(vnode_t *vn, off_t offset);
+static int tmpfs_cleanpage(vnode_t *vn, off_t offset, void *pagebuf);
+
+static fs_ops_t tmpfs_ops = {
+        .read_vnode = tmpfs_read_vnode,
+        .delete_vnode = tmpfs_delete_vnode,
+        .query_vnode = tmpfs_query_vnode,
+        .umount = tmpfs_umount
+};
+
+static vnode_ops_t tmpfs_dir_vops = {
+        .read = NULL,
+        .write = NULL,
+        .mmap = NULL,
+        .create = tmpfs_create,
+        .mknod = tmpfs_mknod,
+        .lookup = tmpfs_lookup,
+        .link = tmpfs_link,
+        .unlink = tmpfs_unlink,
+        .mkdir = tmpfs_mkdir,
+        .rmdir = tmpfs_rmdir,
+        .readdir = tmpfs_readdir,
+        .stat = tmpfs_stat,
+        .fillpage = NULL,
+        .dirtypage = NULL,
+        .cleanpage = NULL
+};
+
+static vnode_ops_t tmpfs_file_vops = {
+        .read = tmpfs_read,
+        .write = tmpfs_write,
+        .mmap = tmpfs_mmap,
+        .create = NULL,
+        .mknod = NULL,
+        .lookup = NULL,
+        .link = NULL,
+        .unlink = NULL,
+        .mkdir = NULL,
+        .rmdir = NULL,
+        .readdir = NULL,
+        .stat = tmpfs_stat,
+        .fillpage = tmpfs_fillpage,
+        .dirtypage = tmpfs_dirtypage,
+        .cleanpage = tmpfs_cleanpage
+};
+
+static slab_allocator_t *tmpfs_inode_allocator = NULL;
+static slab_allocator_t *tmpfs_dirent_allocator = NULL;
+
+static __attribute__((unused)) void
+tmpfs_init(void)
+{
+        tmpfs_inode_allocator = slab_allocator_create("tmpfs_inode", sizeof(tmpfs_inode_t));
+        KASSERT(NULL != tmpfs_inode_allocator);
+        tmpfs_dirent_allocator = slab_allocator_create("tmpfs_dirent", sizeof(tmpfs_dirent_t));
+        KASSERT(NULL != tmpfs_dirent_allocator);
+}
+init_func(tmpfs_init);
+
+/* ---------------------------------------------------------------------- */
+
+static list_t *
+tmpfs_inode_bucket(tmpfs_t *tf, ino_t ino)
+{
+        return &tf->tf_inodes[(uint32_t)ino % TMPFS_INODE_BUCKETS];
+}
+
+static tmpfs_inode_t *
+tmpfs_inode_find(tmpfs_t *tf, ino_t ino)
+{
+        tmpfs_inode_t *ti;
+        list_iterate_begin(tmpfs_inode_bucket(tf, ino), ti, tmpfs_inode_t, ti_link) {
+                if (ti->ti_ino == ino)
+                        return ti;
+        } list_iterate_end();
+        return NULL;
+}
+
+/* Makes a new inode with no names; the caller links it somewhere */
+static tmpfs_inode_t *
+tmpfs_inode_alloc(tmpfs_t *tf, int mode, devid_t devid)
+{
+        tmpfs_inode_t *ti = slab_obj_alloc(tmpfs_inode_allocator);
+        if (NULL == ti)
+                return NULL;
+        ti->ti_ino = tf->tf_nextino++;
+        ti->ti_mode = mode;
+        ti->ti_nlink = 0;
+        ti->ti_devid = devid;
+        ti->ti_len = 0;
+        ti->ti_parent = ti->ti_ino;
+        list_init(&ti->ti_dirents);
+        ti->ti_nextoff = TMPFS_OFF_FIRST;
+        list_insert_head(tmpfs_inode_bucket(tf, ti->ti_ino), &ti->ti_link);
+        return ti;
+}
+
+static void
+tmpfs_inode_free(tmpfs_inode_t *ti)
+{
+        KASSERT(list_empty(&ti->ti_dirents));
+        list_remove(&ti->ti_link);
+        slab_obj_free(tmpfs_inode_allocator, ti);
+}
+
+static list_t *
+tmpfs_dirent_bucket(tmpfs_t *tf, ino_t dir, const char *name, size_t len)
+{
+        uint32_t h = (uint32_t)dir * 2654435761u;
+        size_t i;
+        for (i = 0; i < len; ++i)
+                h = h * 31 + (unsigned char)name[i];
+        return &tf->tf_dirents[h % TMPFS_DIRENT_BUCKETS];
+}
+
+static tmpfs_dirent_t *
+tmpfs_dirent_find(tmpfs_t *tf, tmpfs_inode_t *dir, const char *name, size_t len)
+{
+        tmpfs_dirent_t *td;
+        list_iterate_begin(tmpfs_dirent_bucket(tf, dir->ti_ino, name, len),
+                           td, tmpfs_dirent_t, td_hlink) {
+                if (td->td_dir == dir->ti_ino && td->td_len == len
+                    && !strncmp(td->td_name, name, len))
+                        return td;
+        } list_iterate_end();
+        return NULL;
+}
+
+/* Adds the name to dir, pointing at ti */
+static int
+tmpfs_dirent_add(tmpfs_t *tf, tmpfs_inode_t *dir, const char *name, size_t len,
+                 tmpfs_inode_t *ti)
+{
+        tmpfs_dirent_t *td;
+
+        if (len >= NAME_LEN)
+                return -ENAMETOOLONG;
+        if (NULL == (td = slab_obj_alloc(tmpfs_dirent_allocator)))
+                return -ENOMEM;
+        td->td_dir = dir->ti_ino;
+        td->td_ino = ti->ti_ino;
+        td->td_off = dir->ti_nextoff++;
+        td->td_len = len;
+        memcpy(td->td_name, name, len);
+        td->td_name[len] = '\0';
+        list_insert_head(tmpfs_dirent_bucket(tf, dir->ti_ino, name, len), &td->td_hlink);
+        list_insert_tail(&dir->ti_dirents, &td->td_dlink);
+        dir->ti_len++;
+        ti->ti_nlink++;
+        return 0;
+}
+
+static void
+tmpfs_dirent_remove(tmpfs_inode_t *dir, tmpfs_dirent_t *td)
+{
+        list_remove(&td->td_hlink);
+        list_remove(&td->td_dlink);
+        dir->ti_len--;
+        slab_obj_free(tmpfs_dirent_allocator, td);
+}
+
+/* ---------------------------------------------------------------------- */
+
+int
+tmpfs_mount(struct fs *fs)
+{
+        tmpfs_t *tf;
+        tmpfs_inode_t *root;
+        int i;
+
+        if (NULL == (tf = kmalloc(sizeof(tmpfs_t))))
+                return -ENOMEM;
+        tf->tf_nextino = 1;
+        for (i = 0; i < TMPFS_INODE_BUCKETS; ++i)
+                list_init(&tf->tf_inodes[i]);
+        for (i = 0; i < TMPFS_DIRENT_BUCKETS; ++i)
+                list_init(&tf->tf_dirents[i]);
+
+        if (NULL == (root = tmpfs_inode_alloc(tf, S_IFDIR, 0))) {
+                kfree(tf);
+                return -ENOMEM;
+        }
+        /* the root is named by the mount, not by a directory entry */
+        root->ti_nlink = 1;
+
+        fs->fs_i = tf;
+        fs->fs_op = &tmpfs_ops;
+        fs->fs_root = vget(fs, root->ti_ino);
+        return 0;
+}
+
+static int
+tmpfs_umount(fs_t *fs)
+{
+        tmpfs_t *tf = (tmpfs_t *)fs->fs_i;
+        tmpfs_inode_t *ti;
+        tmpfs_dirent_t *td;
+        int i;
+
+        /* Nothing survives the unmount: once every name is gone and every
+         * inode unlinked, dropping the remaining vnodes frees their pages
+         * and inodes. The names go first, as a directory inode can only
+         * be freed once it is empty. */
+        for (i = 0; i < TMPFS_INODE_BUCKETS; ++i) {
+                list_iterate_begin(&tf->tf_inodes[i], ti, tmpfs_inode_t, ti_link) {
+                        list_iterate_begin(&ti->ti_dirents, td, tmpfs_dirent_t, td_dlink) {
+                                tmpfs_dirent_remove(ti, td);
+                        } list_iterate_end();
+                        ti->ti_nlink = 0;
+                } list_iterate_end();
+        }
+        vnode_flush_all(fs);
+        vput(fs->fs_root);
+
+        /* whatever is left never had a vnode after it was last used */
+        for (i = 0; i < TMPFS_INODE_BUCKETS; ++i) {
+                list_iterate_begin(&tf->tf_inodes[i], ti, tmpfs_inode_t, ti_link) {
+                        tmpfs_inode_free(ti);
+                } list_iterate_end();
+        }
+        kfree(tf);
+        return 0;
+}
+
+static void
+tmpfs_read_vnode(vnode_t *vn)
+{
+        tmpfs_inode_t *ti = tmpfs_inode_find(VNODE_TO_TMPFS(vn), vn->vn_vno);
+
+        KASSERT(NULL != ti);
+        vn->vn_i = ti;
+        vn->vn_mode = ti->ti_mode;
+        vn->vn_len = ti->ti_len;
+        vn->vn_devid = ti->ti_devid;
+        if (S_ISDIR(ti->ti_mode))
+                vn->vn_ops = &tmpfs_dir_vops;
+        else if (S_ISREG(ti->ti_mode))
+                vn->vn_ops = &tmpfs_file_vops;
+        /* vget sets up the ops of special files */
+}
+
+static void
+tmpfs_delete_vnode(vnode_t *vn)
+{
+        tmpfs_inode_t *ti = VNODE_TO_INODE(vn);
+
+        if (0 == ti->ti_nlink)
+                tmpfs_inode_free(ti);
+}
+
+static int
+tmpfs_query_vnode(vnode_t *vn)
+{
+        return 0 < VNODE_TO_INODE(vn)->ti_nlink;
+}
+
+/* ---------------------------------------------------------------------- */
+
+static int
+tmpfs_read(vnode_t *file, off_t offset, void *buf, size_t count)
+{
+        size_t done = 0;
+        pframe_t *pf;
+        int err;
+
+        if (offset >= file->vn_len)
+                return 0;
+        count = MIN(count, (size_t)(file->vn_len - offset));
+        while (done < count) {
+                off_t pos = offset + done;
+                size_t len = MIN(PAGE_SIZE - PAGE_OFFSET(pos), count - done);
+
+                if ((err = pframe_get(&file->vn_mmobj, pos >> PAGE_SHIFT, &pf)) < 0)
+                        return done ? (int)done : err;
+                memcpy((char *)buf + done, (char *)pf->pf_addr + PAGE_OFFSET(pos), len);
+                done += len;
+        }
+        return done;
+}
+
+static int
+tmpfs_write(vnode_t *file, off_t offset, const void *buf, size_t count)
+{
+        size_t done = 0;
+        pframe_t *pf;
+        int err;
+
+        while (done < count) {
+                off_t pos = offset + done;
+                size_t len = MIN(PAGE_SIZE - PAGE_OFFSET(pos), count - done);
+
+                if ((err = pframe_get(&file->vn_mmobj, pos >> PAGE_SHIFT, &pf)) < 0) {
+                        if (0 == done)
+                                return err;
+                        break;
+                }
+                memcpy((char *)pf->pf_addr + PAGE_OFFSET(pos), (const char *)buf + done, len);
+                done += len;
+        }
+        if (offset + (off_t)done > file->vn_len) {
+                file->vn_len = offset + done;
+                VNODE_TO_INODE(file)->ti_len = file->vn_len;
+        }
+        return done;
+}
+
+static int
+tmpfs_mmap(vnode_t *file, vmarea_t *vma, mmobj_t **ret)
+{
+        vref(file);
+        *ret = &file->vn_mmobj;
+        return 0;
+}
+
+/* A new page of a file is a hole: zero it, and pin it since there is no
+ * backing store to page it out to */
+static int
+tmpfs_fillpage(vnode_t *vn, off_t offset, void *pagebuf)
+{
+        pframe_t *pf = pframe_get_resident(&vn->vn_mmobj, offset >> PAGE_SHIFT);
+
+        KASSERT(NULL != pf && pf->pf_addr == pagebuf);
+        memset(pagebuf, 0, PAGE_SIZE);
+        pframe_pin(pf);
+        return 0;
+}
+
+static int
+tmpfs_dirtypage(vnode_t *vn, off_t offset)
+{
+        return 0;
+}
+
+/* Only called when the pages are being thrown away */
+static int
+tmpfs_cleanpage(vnode_t *vn, off_t offset, void *pagebuf)
+{
+        return 0;
+}
+
+/* ---------------------------------------------------------------------- */
+
+/* Makes a new inode with the given mode named name in dir */
+static int
+tmpfs_make(vnode_t *dir, const char *name, size_t name_len, int mode,
+           devid_t devid, tmpfs_inode_t **result)
+{
+        tmpfs_t *tf = VNODE_TO_TMPFS(dir);
+        tmpfs_inode_t *dti = VNODE_TO_INODE(dir);
+        tmpfs_inode_t *ti;
+        int err;
+
+        if (NULL != tmpfs_dirent_find(tf, dti, name, name_len))
+                return -EEXIST;
+        if (NULL == (ti = tmpfs_inode_alloc(tf, mode, devid)))
+                return -ENOMEM;
+        if (0 > (err = tmpfs_dirent_add(tf, dti, name, name_len, ti))) {
+                tmpfs_inode_free(ti);
+                return err;
+        }
+        ti->ti_parent = dti->ti_ino;
+        dir->vn_len = dti->ti_len;
+        *result = ti;
+        return 0;
+}
+
+static int
+tmpfs_create(vnode_t *dir, const char *name, size_t name_len, vnode_t **result)
+{
+        tmpfs_inode_t *ti;
+        int err;
+
+        if (0 > (err = tmpfs_make(dir, name, name_len, S_IFREG, 0, &ti)))
+                return err;
+        *result = vget(dir->vn_fs, ti->ti_ino);
+        return 0;
+}
+
+static int
+tmpfs_mknod(vnode_t *dir, const char *name, size_t name_len, int mode, devid_t devid)
+{
+        tmpfs_inode_t *ti;
+
+        if (!S_ISCHR(mode) && !S_ISBLK(mode))
+                return -EINVAL;
+        return tmpfs_make(dir, name, name_len, mode, devid, &ti);
+}
+
+static int
+tmpfs_mkdir(vnode_t *dir, const char *name, size_t name_len)
+{
+        tmpfs_inode_t *ti;
+
+        return tmpfs_make(dir, name, name_len, S_IFDIR, 0, &ti);
+}
+
+static int
+tmpfs_lookup(vnode_t *dir, const char *name, size_t name_len, vnode_t **result)
+{
+        tmpfs_inode_t *dti = VNODE_TO_INODE(dir);
+        tmpfs_dirent_t *td;
+
+        if (1 == name_len && '.' == name[0]) {
+                vref(dir);
+                *result = dir;
+                return 0;
+        }
+        if (2 == name_len && '.' == name[0] && '.' == name[1]) {
+#ifdef __MOUNTING__
+                /* ".." of the root leaves the fs through the mount point */
+                if (dir == dir->vn_fs->fs_root && NULL != dir->vn_fs->fs_mtpt) {
+                        vnode_t *mtpt = dir->vn_fs->fs_mtpt;
+                        return mtpt->vn_ops->lookup(mtpt, name, name_len, result);
+                }
+#endif
+                *result = vget(dir->vn_fs, dti->ti_parent);
+                return 0;
+        }
+        if (NULL == (td = tmpfs_dirent_find(VNODE_TO_TMPFS(dir), dti, name, name_len)))
+                return -ENOENT;
+        *result = vget(dir->vn_fs, td->td_ino);
+        return 0;
+}
+
+static int
+tmpfs_link(vnode_t *oldvnode, vnode_t *dir, const char *name, size_t name_len)
+{
+        tmpfs_t *tf = VNODE_TO_TMPFS(dir);
+        tmpfs_inode_t *dti = VNODE_TO_INODE(dir);
+        int err;
+
+        if (oldvnode->vn_fs != dir->vn_fs)
+                return -EXDEV;
+        if (S_ISDIR(oldvnode->vn_mode))
+                return -EPERM;
+        if (NULL != tmpfs_dirent_find(tf, dti, name, name_len))
+                return -EEXIST;
+        if (0 > (err = tmpfs_dirent_add(tf, dti, name, name_len, VNODE_TO_INODE(oldvnode))))
+                return err;
+        dir->vn_len = dti->ti_len;
+        return 0;
+}
+
+/* Removes name from dir; the named inode is freed once nothing refers to
+ * it. Taking and dropping a vnode reference here is what lets vput
+ * notice an unlinked file with only cached pages left and release it. */
+static int
+tmpfs_remove(vnode_t *dir, const char *name, size_t name_len, int isdir)
+{
+        tmpfs_t *tf = VNODE_TO_TMPFS(dir);
+        tmpfs_inode_t *dti = VNODE_TO_INODE(dir);
+        tmpfs_inode_t *ti;
+        tmpfs_dirent_t *td;
+        vnode_t *vn;
+
+        if (NULL == (td = tmpfs_dirent_find(tf, dti, name, name_len)))
+                return -ENOENT;
+        ti = tmpfs_inode_find(tf, td->td_ino);
+        KASSERT(NULL != ti);
+        if (isdir && !S_ISDIR(ti->ti_mode))
+                return -ENOTDIR;
+        if (!isdir && S_ISDIR(ti->ti_mode))
+                return -EPERM;
+        if (isdir && !list_empty(&ti->ti_dirents))
+                return -ENOTEMPTY;
+
+        vn = vget(dir->vn_fs, ti->ti_ino);
+        tmpfs_dirent_remove(dti, td);
+        dir->vn_len = dti->ti_len;
+        ti->ti_nlink--;
+        vput(vn);
+        return 0;
+}
+
+static int
+tmpfs_unlink(vnode_t *dir, const char *name, size_t name_len)
+{
+        return tmpfs_remove(dir, name, name_len, 0);
+}
+
+static int
+tmpfs_rmdir(vnode_t *dir, const char *name, size_t name_len)
+{
+        return tmpfs_remove(dir, name, name_len, 1);
+}
+
+/* Cookies are 0 for ".", 1 for ".." and then each entry's td_off, which
+ * increase in list order; the return value moves the cookie on to the
+ * next entry */
+static int
+tmpfs_readdir(vnode_t *dir, off_t offset, struct dirent *d)
+{
+        tmpfs_inode_t *dti = VNODE_TO_INODE(dir);
+        tmpfs_dirent_t *td;
+
+        if (TMPFS_OFF_DOT == offset || TMPFS_OFF_DOTDOT == offset) {
+                d->d_ino = (TMPFS_OFF_DOT == offset) ? dti->ti_ino : dti->ti_parent;
+                strcpy(d->d_name, (TMPFS_OFF_DOT == offset) ? "." : "..");
+                d->d_off = offset + 1;
+                return 1;
+        }
+        list_iterate_begin(&dti->ti_dirents, td, tmpfs_dirent_t, td_dlink) {
+                if (td->td_off >= offset) {
+                        d->d_ino = td->td_ino;
+                        strcpy(d->d_name, td->td_name);
+                        d->d_off = td->td_off + 1;
+                        return d->d_off - offset;
+                }
+        } list_iterate_end();
+        return 0;
+}
+
+static int
+tmpfs_stat(vnode_t *vn, struct stat *ss)
+{
+        tmpfs_inode_t *ti = VNODE_TO_INODE(vn);
+
+        memset(ss, 0, sizeof(*ss));
+        ss->st_mode = ti->ti_mode;
+        ss->st_ino = ti->ti_ino;
+        ss->st_nlink = ti->ti_nlink;
+        ss->st_rdev = ti->ti_devid;
+        ss->st_size = ti->ti_len;
+        ss->st_blksize = PAGE_SIZE;
+        ss->st_blocks = (ti->ti_len + PAGE_SIZE - 1) >> PAGE_SHIFT;
+        return 0;
+}
@@ -30,15 +30,23 @@
 #include "fs/vfs.h"
 #include "fs/file.h"
 #include "fs/vnode.h"
+#include "fs/dirlock.h"
+#include "fs/dcache.h"
+#include "fs/uio.h"
+#include "fs/tmpfs.h"
+#include "fs/fdtable.h"
 #include "fs/vfs_syscall.h"
 #include "fs/open.h"
 #include "fs/fcntl.h"
 #include "fs/lseek.h"
 #include "mm/kmalloc.h"
+#include "mm/page.h"
+#include "mm/pframe.h"
 #include "util/string.h"
 #include "util/printf.h"
 #include "fs/stat.h"
 #include "util/debug.h"
+#include "util/trace.h"
 
 /*
  * Syscalls for vfs. Refer to comments or man pages for implementation.
@@ -46,6 +54,84 @@
  * negative error code.
  */
 
+/*
+ * fget for the length of one syscall. Only a process's own threads can
+ * change its file table, so while a single-threaded process is in a
+ * syscall nothing can close fd under it, and the file_t can be used
+ * without the fref/fput round trip. *putp tells fdput whether a reference
+ * was taken.
+ */
+static file_t *
+fdget(int fd, int *putp)
+{
+        file_t *file = fd_lookup(curproc, fd);
+
+        *putp = 0;
+#ifdef __MTP__
+        if (NULL != file && curproc->p_threads.l_next != curproc->p_threads.l_prev) {
+                *putp = 1;
+                fref(file);
+        }
+#endif
+        return file;
+}
+
+static void
+fdput(file_t *file, int put)
+{
+        if (put)
+                fput(file);
+}
+
+/*
+ * fdget() fd for reading or writing, making the checks shared by the read
+ * and write calls. mode is FMODE_READ or FMODE_WRITE.
+ */
+static int
+fget_rw(int fd, int mode, file_t **filep, int *putp)
+{
+        file_t *file;
+
+        if (NULL == (file = fdget(fd, putp)))
+                return -EBADF;
+        if (S_ISDIR(file->f_vnode->vn_mode)) {
+                fdput(file, *putp);
+                return -EISDIR;
+        }
+        if (!(file->f_mode & mode)) {
+                fdput(file, *putp);
+                return -EBADF;
+        }
+        *filep = file;
+        return 0;
+}
+
+/* Moves file's f_pos as lseek(2) does; returns the new position or -EINVAL */
+static int
+file_lseek(file_t *file, int offset, int whence)
+{
+        int newPos;
+        if (whence == SEEK_SET) {
+                newPos = offset;
+                grading_dbg("(GRADING2B)\n");
+        } else if (whence == SEEK_CUR) {
+                newPos = file->f_pos + offset;
+                grading_dbg("(GRADING2A)\n");
+        } else if (whence == SEEK_END) {
+                newPos = file->f_vnode->vn_len + offset;
+                grading_dbg("(GRADING2A)\n");
+        } else {
+                grading_dbg("(GRADING2B)\n");
+                return -EINVAL;
+        }
+        if (newPos < 0) {
+                grading_dbg("(GRADING2B)\n");
+                return -EINVAL;
+        }
+        file->f_pos = newPos;
+        return newPos;
+}
+
 /* To read a file:
  *      o fget(fd)
  *      o call its virtual read vn_op
@@ -65,36 +151,19 @@
 int
 do_read(int fd, void *buf, size_t nbytes)
 {
-        if (-1 == fd) {
-                dbg(DBG_PRINT, "(GRADING2B)\n");
-                return -EBADF;
-        }
-        file_t *file = fget(fd);
-        if (NULL == file) {
-                dbg(DBG_PRINT, "(GRADING2B)\n");
-                return -EBADF;
-        }
-        if (S_ISDIR(file->f_vnode->vn_mode)) {
-                fput(file);
-                dbg(DBG_PRINT, "(GRADING2B)\n");
-                return -EISDIR;
-        }
-        if (0 == (file->f_mode&FMODE_READ)) {
-                fput(file);
-                dbg(DBG_PRINT, "(GRADING2B)\n");
-                return -EBADF;
-        }
-        unsigned int bytes_read = file->f_vnode->vn_ops->read(file->f_vnode, file->f_pos, buf, nbytes);
-        if (bytes_read == nbytes) {
-                do_lseek(fd, nbytes, SEEK_CUR);
-                dbg(DBG_PRINT, "(GRADING2B)\n");
-        } else {
-                do_lseek(fd, 0, SEEK_END);
-                dbg(DBG_PRINT, "(GRADING2A)\n");
+        file_t *file;
+        int put, ret;
+
+        if ((ret = fget_rw(fd, FMODE_READ, &file, &put)) < 0) {
+                grading_dbg("(GRADING2B)\n");
+                return ret;
         }
-        fput(file);
-        dbg(DBG_PRINT, "(GRADING2A)\n");
-        return bytes_read;
+        ret = file->f_vnode->vn_ops->read(file->f_vnode, file->f_pos, buf, nbytes);
+        if (ret > 0)
+                file->f_pos += ret;
+        fdput(file, put);
+        grading_dbg("(GRADING2A)\n");
+        return ret;
 }
 
 /* Very similar to do_read.  Check f_mode to be sure the file is writable.  If
@@ -108,44 +177,213 @@ do_read(int fd, void *buf, size_t nbytes)
 int
 do_write(int fd, const void *buf, size_t nbytes)
 {
-        if (-1 == fd) {
-                dbg(DBG_PRINT, "(GRADING2B)\n");
-                return -EBADF;
+        file_t *file;
+        int put, ret;
+
+        if ((ret = fget_rw(fd, FMODE_WRITE, &file, &put)) < 0) {
+                grading_dbg("(GRADING2B)\n");
+                return ret;
         }
-        file_t *file = fget(fd);
-        if (NULL == file) {
-                dbg(DBG_PRINT, "(GRADING2B)\n");
-                return -EBADF;
+        if (file->f_mode & FMODE_APPEND)
+                file->f_pos = file->f_vnode->vn_len;
+        ret = file->f_vnode->vn_ops->write(file->f_vnode, file->f_pos, buf, nbytes);
+        if (ret > 0)
+                file->f_pos += ret;
+
+        KASSERT((S_ISCHR(file->f_vnode->vn_mode)) || (S_ISBLK(file->f_vnode->vn_mode)) || 
+                (S_ISFIFO(file->f_vnode->vn_mode)) ||
+                ((S_ISREG(file->f_vnode->vn_mode)) && (file->f_pos <= file->f_vnode->vn_len))); 
+                /* cursor must not go past end of file for these file types */
+        grading_dbg("(GRADING2A 3.a)\n");
+
+        fdput(file, put);
+        grading_dbg("(GRADING2A)\n");
+        return ret;
+}
+
+/* Read at offset without touching f_pos.
+ *
+ * Error cases are those of do_read, plus:
+ *      o EINVAL
+ *        offset is negative.
+ */
+int
+do_pread(int fd, void *buf, size_t nbytes, off_t offset)
+{
+        file_t *file;
+        int put, ret;
+
+        if (offset < 0)
+                return -EINVAL;
+        if ((ret = fget_rw(fd, FMODE_READ, &file, &put)) < 0)
+                return ret;
+        ret = file->f_vnode->vn_ops->read(file->f_vnode, offset, buf, nbytes);
+        fdput(file, put);
+        return ret;
+}
+
+/* Write at offset without touching f_pos. The write goes to offset even
+ * if the file was opened with O_APPEND. */
+int
+do_pwrite(int fd, const void *buf, size_t nbytes, off_t offset)
+{
+        file_t *file;
+        int put, ret;
+
+        if (offset < 0)
+                return -EINVAL;
+        if ((ret = fget_rw(fd, FMODE_WRITE, &file, &put)) < 0)
+                return ret;
+        ret = file->f_vnode->vn_ops->write(file->f_vnode, offset, buf, nbytes);
+        fdput(file, put);
+        return ret;
+}
+
+/* Read into each buffer of iov in turn, starting at f_pos, with a single
+ * fget. Stops at the first short read. If an error happens after some
+ * bytes have been read, those are reported and the error is dropped.
+ *
+ * Error cases are those of do_read, plus:
+ *      o EINVAL
+ *        iovcnt is not between 1 and IOV_MAX.
+ */
+int
+do_readv(int fd, const struct iovec *iov, int iovcnt)
+{
+        file_t *file;
+        vnode_t *vn;
+        int i, n, put, total = 0;
+
+        if (iovcnt <= 0 || iovcnt > IOV_MAX)
+                return -EINVAL;
+        if ((n = fget_rw(fd, FMODE_READ, &file, &put)) < 0)
+                return n;
+
+        vn = file->f_vnode;
+        for (i = 0; i < iovcnt; ++i) {
+                n = vn->vn_ops->read(vn, file->f_pos + total, iov[i].iov_base, iov[i].iov_len);
+                if (n < 0) {
+                        if (0 == total)
+                                total = n;
+                        break;
+                }
+                total += n;
+                if ((size_t)n < iov[i].iov_len)
+                        break;
         }
-        if (S_ISDIR(file->f_vnode->vn_mode)) {
-                fput(file);
-                dbg(DBG_PRINT, "(GRADING2D)\n");
-                return -EISDIR;
+        if (total > 0)
+                file->f_pos += total;
+        fdput(file, put);
+        return total;
+}
+
+/* The writing counterpart of do_readv. With FMODE_APPEND all of the
+ * buffers go at the end of the file. */
+int
+do_writev(int fd, const struct iovec *iov, int iovcnt)
+{
+        file_t *file;
+        vnode_t *vn;
+        int i, n, put, total = 0;
+
+        if (iovcnt <= 0 || iovcnt > IOV_MAX)
+                return -EINVAL;
+        if ((n = fget_rw(fd, FMODE_WRITE, &file, &put)) < 0)
+                return n;
+
+        vn = file->f_vnode;
+        if (file->f_mode & FMODE_APPEND)
+                file->f_pos = vn->vn_len;
+        for (i = 0; i < iovcnt; ++i) {
+                n = vn->vn_ops->write(vn, file->f_pos + total, iov[i].iov_base, iov[i].iov_len);
+                if (n < 0) {
+                        if (0 == total)
+                                total = n;
+                        break;
+                }
+                total += n;
+                if ((size_t)n < iov[i].iov_len)
+                        break;
         }
-        if (file->f_mode < FMODE_WRITE) {	// ??? < FMODE_WRITE
-                fput(file);
-                dbg(DBG_PRINT, "(GRADING2B)\n");
-                return -EBADF;
+        if (total > 0)
+                file->f_pos += total;
+        fdput(file, put);
+        return total;
+}
+
+/*
+ * Copy up to count bytes from in_fd to out_fd without going through user
+ * memory: each page of the input file is fetched into its page cache and
+ * handed, pinned, straight to the output vnode's write op. If offset is
+ * NULL, in_fd's f_pos is used and advanced; otherwise reading starts at
+ * *offset, which is advanced instead. Returns the number of bytes copied.
+ *
+ * Error cases are those of do_read and do_write, plus:
+ *      o EINVAL
+ *        in_fd is not a regular file, or *offset is negative.
+ */
+int
+do_sendfile(int out_fd, int in_fd, off_t *offset, size_t count)
+{
+        file_t *in, *out;
+        vnode_t *ivn, *ovn;
+        uint32_t done = 0;
+        off_t pos;
+        int n, iput, oput;
+
+        if (NULL != offset && *offset < 0)
+                return -EINVAL;
+        if ((n = fget_rw(in_fd, FMODE_READ, &in, &iput)) < 0)
+                return n;
+        if ((n = fget_rw(out_fd, FMODE_WRITE, &out, &oput)) < 0) {
+                fdput(in, iput);
+                return n;
         }
-        if (file->f_mode&FMODE_APPEND) {
-                do_lseek(fd, 0, SEEK_END);
-                dbg(DBG_PRINT, "(GRADING2B)\n");
+        ivn = in->f_vnode;
+        ovn = out->f_vnode;
+        if (!S_ISREG(ivn->vn_mode)) {
+                fdput(out, oput);
+                fdput(in, iput);
+                return -EINVAL;
         }
-        unsigned int bytes_written = file->f_vnode->vn_ops->write(file->f_vnode, file->f_pos, buf, nbytes);
-        do_lseek(fd, bytes_written, SEEK_CUR);
 
-        KASSERT((S_ISCHR(file->f_vnode->vn_mode)) || (S_ISBLK(file->f_vnode->vn_mode)) || 
-                ((S_ISREG(file->f_vnode->vn_mode)) && (file->f_pos <= file->f_vnode->vn_len))); 
-                /* cursor must not go past end of file for these file types */
-        dbg(DBG_PRINT, "(GRADING2A 3.a)\n");
+        pos = (NULL == offset) ? in->f_pos : *offset;
+        if (out->f_mode & FMODE_APPEND)
+                out->f_pos = ovn->vn_len;
 
-        fput(file);
-        dbg(DBG_PRINT, "(GRADING2A)\n");
-        return bytes_written;
+        n = 0;
+        while (done < count && pos < ivn->vn_len) {
+                uint32_t pgoff = PAGE_OFFSET(pos);
+                size_t len = MIN(MIN(PAGE_SIZE - pgoff, count - done),
+                                 (size_t)(ivn->vn_len - pos));
+                pframe_t *pf;
+
+                if ((n = pframe_get(&ivn->vn_mmobj, pos >> PAGE_SHIFT, &pf)) < 0)
+                        break;
+                pframe_pin(pf);
+                n = ovn->vn_ops->write(ovn, out->f_pos, (char *)pf->pf_addr + pgoff, len);
+                pframe_unpin(pf);
+                if (n < 0)
+                        break;
+                out->f_pos += n;
+                pos += n;
+                done += n;
+                if ((size_t)n < len)
+                        break;
+        }
+
+        if (NULL == offset)
+                in->f_pos = pos;
+        else
+                *offset = pos;
+        fdput(out, oput);
+        fdput(in, iput);
+        return (n < 0 && 0 == done) ? n : (int)done;
 }
 
 /*
- * Zero curproc->p_files[fd], and fput() the file. Return 0 on success
+ * Remove fd from curproc's descriptor table, and fput() the file. Return 0
+ * on success
  *
  * Error cases you must handle for this function at the VFS level:
  *      o EBADF
@@ -155,18 +393,17 @@ int
 do_close(int fd)
 {
         if (-1 == fd) {
-                dbg(DBG_PRINT, "(GRADING2B)\n");
+                grading_dbg("(GRADING2B)\n");
                 return -EBADF;
         }
-        file_t *file = fget(fd);
-        if (NULL == file) {
-                dbg(DBG_PRINT, "(GRADING2B)\n");
-                return -EBADF;
+        file_t *file;
+        int err = fd_remove(curproc, fd, &file);
+        if (err < 0) {
+                grading_dbg("(GRADING2B)\n");
+                return err;
         }
         fput(file);
-        fput(file);
-        curproc->p_files[fd] = NULL;
-        dbg(DBG_PRINT, "(GRADING2A)\n");
+        grading_dbg("(GRADING2A)\n");
         return 0;
 }
 
@@ -190,22 +427,26 @@ int
 do_dup(int fd)
 {
         if (-1 == fd) {
-                dbg(DBG_PRINT, "(GRADING2B)\n");
+                grading_dbg("(GRADING2B)\n");
                 return -EBADF;
         }
-        file_t *file = fget(fd);
+        file_t *file = fd_lookup(curproc, fd);
         if (NULL == file) {
-                dbg(DBG_PRINT, "(GRADING2B)\n");
+                grading_dbg("(GRADING2B)\n");
                 return -EBADF;
         }
         int new_fd = get_empty_fd(curproc);
         if (new_fd < 0) {
-                fput(file);
-                dbg(DBG_PRINT, "(GRADING2D)\n");
+                grading_dbg("(GRADING2D)\n");
                 return -EMFILE;
         }
-        curproc->p_files[new_fd] = file;
-        dbg(DBG_PRINT, "(GRADING2B)\n");
+        fref(file);
+        int err = fd_install(curproc, new_fd, file);
+        if (err < 0) {
+                fput(file);
+                return err;
+        }
+        grading_dbg("(GRADING2B)\n");
         return new_fd;
 }
 
@@ -222,28 +463,31 @@ int
 do_dup2(int ofd, int nfd)
 {
         if (-1 == ofd) {
-                dbg(DBG_PRINT, "(GRADING2B)\n");
+                grading_dbg("(GRADING2B)\n");
                 return -EBADF;
         }
-        file_t *file = fget(ofd);
+        file_t *file = fd_lookup(curproc, ofd);
         if (NULL == file) {
-                dbg(DBG_PRINT, "(GRADING2B)\n");
+                grading_dbg("(GRADING2B)\n");
                 return -EBADF;
         }
-        if (nfd < 0 || nfd >= NFILES) {
-                fput(file);
-                dbg(DBG_PRINT, "(GRADING2D)\n");
+        if (nfd < 0 || nfd >= FDTABLE_MAX) {
+                grading_dbg("(GRADING2D)\n");
                 return -EBADF;
         }
-        file_t *target_file = fget(nfd);
-	// ??? ofd == nfd
-        if (NULL != target_file) {
-                fput(target_file);
+        if (nfd == ofd)
+                return nfd;
+        if (NULL != fd_lookup(curproc, nfd)) {
                 do_close(nfd);
-                dbg(DBG_PRINT, "(GRADING2B)\n");
+                grading_dbg("(GRADING2B)\n");
         }
-        curproc->p_files[nfd] = file;
-        dbg(DBG_PRINT, "(GRADING2B)\n");
+        fref(file);
+        int err = fd_install(curproc, nfd, file);
+        if (err < 0) {
+                fput(file);
+                return err;
+        }
+        grading_dbg("(GRADING2B)\n");
         return nfd;
 }
 
@@ -276,7 +520,7 @@ int
 do_mknod(const char *path, int mode, unsigned devid)
 {
         if (!S_ISCHR(mode) && !S_ISBLK(mode)) {
-                dbg(DBG_PRINT, "(GRADING2D)\n");
+                grading_dbg("(GRADING2D)\n");
                 return -EINVAL;
         }
         size_t namelen = 0;
@@ -284,7 +528,7 @@ do_mknod(const char *path, int mode, unsigned devid)
         vnode_t *dir_vnode, *target_vnode;
         int val = dir_namev(path, &namelen, (const char **)&name, NULL, &dir_vnode);
         if (val < 0) {
-                dbg(DBG_PRINT, "(GRADING2D)\n");
+                grading_dbg("(GRADING2D)\n");
                 return val;
         }
 
@@ -292,16 +536,19 @@ do_mknod(const char *path, int mode, unsigned devid)
         if (0 == val) {
                 vput(dir_vnode);
                 vput(target_vnode);
-                dbg(DBG_PRINT, "(GRADING2D)\n");
+                grading_dbg("(GRADING2D)\n");
                 return -EEXIST;
         }
 
         KASSERT(NULL != dir_vnode->vn_ops->mknod); /* dir_vnode is the directory vnode where you will create the target special file */
-        dbg(DBG_PRINT, "(GRADING2A 3.b)\n");
+        grading_dbg("(GRADING2A 3.b)\n");
 
+        vnode_dir_wrlock(dir_vnode);
+        dcache_remove(dir_vnode, name, namelen);
         val = dir_vnode->vn_ops->mknod(dir_vnode, name, namelen, mode, devid);
+        vnode_dir_wrunlock(dir_vnode);
         vput(dir_vnode);
-        dbg(DBG_PRINT, "(GRADING2A)\n");
+        grading_dbg("(GRADING2A)\n");
         return val;
 }
 
@@ -327,27 +574,30 @@ do_mkdir(const char *path)
         char *name;
         int val = dir_namev(path, &namelen, (const char **)&name, NULL, &dir_vnode);
         if (val < 0) {
-                dbg(DBG_PRINT, "(GRADING2B)\n");
+                grading_dbg("(GRADING2B)\n");
                 return val;
         }
         val = lookup(dir_vnode, name, namelen, &to_vnode);
         if (0 == val) {
                 vput(dir_vnode);
                 vput(to_vnode);
-                dbg(DBG_PRINT, "(GRADING2B)\n");
+                grading_dbg("(GRADING2B)\n");
                 return -EEXIST;
         }
         if (val != -ENOENT) {
                 vput(dir_vnode);
-                dbg(DBG_PRINT, "(GRADING2B)\n");
+                grading_dbg("(GRADING2B)\n");
                 return val;
         }
         KASSERT(NULL != dir_vnode->vn_ops->mkdir); /* dir_vnode is the directory vnode where you will create the target directory */
-        dbg(DBG_PRINT, "(GRADING2A 3.c)\n");
+        grading_dbg("(GRADING2A 3.c)\n");
 
+        vnode_dir_wrlock(dir_vnode);
+        dcache_remove(dir_vnode, name, namelen);
         val = dir_vnode->vn_ops->mkdir(dir_vnode, name, namelen);
+        vnode_dir_wrunlock(dir_vnode);
         vput(dir_vnode);
-        dbg(DBG_PRINT, "(GRADING2A)\n");
+        grading_dbg("(GRADING2A)\n");
         return val;
 }
 
@@ -377,40 +627,46 @@ do_rmdir(const char *path)
         char *name;
         int val = dir_namev(path, &namelen, (const char **)&name, NULL, &dir_vnode);
         if (val < 0) {
-                dbg(DBG_PRINT, "(GRADING2B)\n");
+                grading_dbg("(GRADING2B)\n");
                 return val;
         }
         if (name_match(".", name, namelen)) {
                 vput(dir_vnode);
-                dbg(DBG_PRINT, "(GRADING2B)\n");
+                grading_dbg("(GRADING2B)\n");
                 return -EINVAL;
         }
         if (name_match("..", name, namelen)) {
                 vput(dir_vnode);
-                dbg(DBG_PRINT, "(GRADING2B)\n");
+                grading_dbg("(GRADING2B)\n");
                 return -ENOTEMPTY;
         }
         val = lookup(dir_vnode, name, namelen, &target_vnode);
         if (val < 0) {
                 vput(dir_vnode);
-                dbg(DBG_PRINT, "(GRADING2B)\n");
+                grading_dbg("(GRADING2B)\n");
                 return val;
         }
         if (!S_ISDIR(target_vnode->vn_mode)) {
                 vput(target_vnode);
                 vput(dir_vnode);
-                dbg(DBG_PRINT, "(GRADING2B)\n");
+                grading_dbg("(GRADING2B)\n");
                 return -ENOTDIR;
         }
-        vput(target_vnode);
 
         KASSERT(NULL != dir_vnode->vn_ops->rmdir); /* dir_vnode is the directory vnode where you will remove the target directory */
-        dbg(DBG_PRINT, "(GRADING2A 3.d)\n");
-        dbg(DBG_PRINT, "(GRADING2B)\n");
+        grading_dbg("(GRADING2A 3.d)\n");
+        grading_dbg("(GRADING2B)\n");
         /* please use TWO consecutive "conforming dbg() calls" for this since this function is not executed if you just start and stop weenix */
+        vnode_dir_wrlock(dir_vnode);
+        dcache_remove(dir_vnode, name, namelen);
         val = dir_vnode->vn_ops->rmdir(dir_vnode, name, namelen);
+        vnode_dir_wrunlock(dir_vnode);
+        /* its inode number may be reused for a new directory */
+        if (0 == val)
+                dcache_purge_dir(target_vnode);
+        vput(target_vnode);
         vput(dir_vnode);
-        dbg(DBG_PRINT, "(GRADING2B)\n");
+        grading_dbg("(GRADING2B)\n");
         return val;
 }
 
@@ -436,30 +692,33 @@ do_unlink(const char *path)
         char *name;
         int val = dir_namev(path, &namelen, (const char **)&name, NULL, &dir_vnode);
         if (val < 0) {
-                dbg(DBG_PRINT, "(GRADING2D)\n");
+                grading_dbg("(GRADING2D)\n");
                 return val;
         }
         val = lookup(dir_vnode, name, namelen, &target_vnode);
         if (val < 0) {
                 vput(dir_vnode);
-                dbg(DBG_PRINT, "(GRADING2B)\n");
+                grading_dbg("(GRADING2B)\n");
                 return val;
         }
         if (S_ISDIR(target_vnode->vn_mode)) {
                 vput(target_vnode);
                 vput(dir_vnode);
-                dbg(DBG_PRINT, "(GRADING2B)\n");
+                grading_dbg("(GRADING2B)\n");
                 return -EPERM;
         }
         vput(target_vnode);
 
         KASSERT(NULL != dir_vnode->vn_ops->unlink); /* dir_vnode is the directory vnode where you will unlink the target directory */
-        dbg(DBG_PRINT, "(GRADING2A 3.e)\n");
-        dbg(DBG_PRINT, "(GRADING2B)\n");
+        grading_dbg("(GRADING2A 3.e)\n");
+        grading_dbg("(GRADING2B)\n");
         /* please use TWO consecutive "conforming dbg() calls" for this since this function is not executed if you just start and stop weenix */
+        vnode_dir_wrlock(dir_vnode);
+        dcache_remove(dir_vnode, name, namelen);
         val = dir_vnode->vn_ops->unlink(dir_vnode, name, namelen);
+        vnode_dir_wrunlock(dir_vnode);
         vput(dir_vnode);
-        dbg(DBG_PRINT, "(GRADING2B)\n");
+        grading_dbg("(GRADING2B)\n");
         return val;
 }
 
@@ -490,19 +749,19 @@ do_link(const char *from, const char *to)
         vnode_t *from_vnode, *dir_vnode, *to_vnode;
         int val = open_namev(from, 0, &from_vnode, NULL);
         if (val < 0) {
-                dbg(DBG_PRINT, "(GRADING2B)\n");
+                grading_dbg("(GRADING2B)\n");
                 return val;
         }
         if (S_ISDIR(from_vnode->vn_mode)) {
                 vput(from_vnode);
-                dbg(DBG_PRINT, "(GRADING2D)\n");
+                grading_dbg("(GRADING2D)\n");
                 return -EPERM;
         }
         size_t namelen;
         char *name;
         val = dir_namev(to, &namelen, (const char **)&name, NULL, &dir_vnode);
         if (val < 0) {
-                dbg(DBG_PRINT, "(GRADING2D)\n");
+                grading_dbg("(GRADING2D)\n");
                 return val;
         }
         val = lookup(dir_vnode, (const char *)name, namelen, &to_vnode);
@@ -510,19 +769,22 @@ do_link(const char *from, const char *to)
                 vput(from_vnode);
                 vput(dir_vnode);
                 vput(to_vnode);
-                dbg(DBG_PRINT, "(GRADING2D)\n");
+                grading_dbg("(GRADING2D)\n");
                 return -EEXIST;
         }
         if (val != -ENOENT) {
                 vput(from_vnode);
                 vput(dir_vnode);
-                dbg(DBG_PRINT, "(GRADING2B)\n");
+                grading_dbg("(GRADING2B)\n");
                 return val;
         }
+        vnode_dir_wrlock(dir_vnode);
+        dcache_remove(dir_vnode, (const char *)name, namelen);
         val = dir_vnode->vn_ops->link(from_vnode, dir_vnode, (const char *)name, namelen);
+        vnode_dir_wrunlock(dir_vnode);
         vput(from_vnode);
         vput(dir_vnode);
-        dbg(DBG_PRINT, "(GRADING2D)\n");
+        grading_dbg("(GRADING2D)\n");
         return val;
 }
 
@@ -533,17 +795,19 @@ do_link(const char *from, const char *to)
  * Note that this does not provide the same behavior as the
  * Linux system call (if unlink fails then two links to the
  * file could exist).
+ *
+ * do_link and do_unlink keep the dentry cache up to date for both names.
  */
 int
 do_rename(const char *oldname, const char *newname)
 {
         int val = do_link(oldname, newname);
         if (val < 0) {
-                dbg(DBG_PRINT, "(GRADING2B)\n");
+                grading_dbg("(GRADING2B)\n");
                 return val;
         }
         val = do_unlink(oldname);
-        dbg(DBG_PRINT, "(GRADING2D)\n");
+        grading_dbg("(GRADING2D)\n");
         return val;
 }
 
@@ -566,17 +830,17 @@ do_chdir(const char *path)
         vnode_t *new_dir;
         int val = open_namev(path, 0, &new_dir, NULL);
         if (val < 0) {
-                dbg(DBG_PRINT, "(GRADING2B)\n");
+                grading_dbg("(GRADING2B)\n");
                 return val;
         }
         if (!S_ISDIR(new_dir->vn_mode)) {
                 vput(new_dir);
-                dbg(DBG_PRINT, "(GRADING2B)\n");
+                grading_dbg("(GRADING2B)\n");
                 return -ENOTDIR;
         }
         vput(curproc->p_cwd);
         curproc->p_cwd = new_dir;
-        dbg(DBG_PRINT, "(GRADING2B)\n");
+        grading_dbg("(GRADING2B)\n");
         return 0;
 }
 
@@ -598,30 +862,59 @@ do_chdir(const char *path)
 int
 do_getdent(int fd, struct dirent *dirp)
 {
-        if (-1 == fd) {
-                dbg(DBG_PRINT, "(GRADING2B)\n");
-                return -EBADF;
-        }
-        file_t *file = fget(fd);
-        if (NULL == file) {
-                dbg(DBG_PRINT, "(GRADING2B)\n");
+        file_t *file;
+        int put, ret;
+
+        if (NULL == (file = fdget(fd, &put))) {
+                grading_dbg("(GRADING2B)\n");
                 return -EBADF;
         }
         if (!S_ISDIR(file->f_vnode->vn_mode) || NULL == file->f_vnode->vn_ops->readdir) {
-                fput(file);
-                dbg(DBG_PRINT, "(GRADING2B)\n");
+                fdput(file, put);
+                grading_dbg("(GRADING2B)\n");
                 return -ENOTDIR;
         }
-        int bytes_read = file->f_vnode->vn_ops->readdir(file->f_vnode, file->f_pos, dirp);
-        if (0 == bytes_read) {
-                fput(file);
-                dbg(DBG_PRINT, "(GRADING2B)\n");
-                return 0;
+        ret = file->f_vnode->vn_ops->readdir(file->f_vnode, file->f_pos, dirp);
+        if (ret > 0) {
+                file->f_pos += ret;
+                ret = sizeof(dirent_t);
         }
-        int val = do_lseek(fd, bytes_read, SEEK_CUR);
-        fput(file);
-        dbg(DBG_PRINT, "(GRADING2B)\n");
-        return val < 0 ? val : (int)sizeof(dirent_t);
+        fdput(file, put);
+        grading_dbg("(GRADING2B)\n");
+        return ret;
+}
+
+/*
+ * do_getdent for up to count entries at once: the file is looked up once
+ * and readdir is called repeatedly, advancing f_pos directly. Returns the
+ * number of entries read (0 at the end of the directory) or -errno; an
+ * error after some entries have been read just ends the batch.
+ */
+int
+do_getdents(int fd, struct dirent *dirp, int count)
+{
+        file_t *file;
+        vnode_t *vn;
+        int n, put, bytes = 0;
+
+        if (NULL == (file = fdget(fd, &put)))
+                return -EBADF;
+        vn = file->f_vnode;
+        if (!S_ISDIR(vn->vn_mode) || NULL == vn->vn_ops->readdir) {
+                fdput(file, put);
+                return -ENOTDIR;
+        }
+
+        vnode_dir_rdlock(vn);
+        for (n = 0; n < count; ++n) {
+                if ((bytes = vn->vn_ops->readdir(vn, file->f_pos, &dirp[n])) <= 0)
+                        break;
+                file->f_pos += bytes;
+        }
+        vnode_dir_rdunlock(vn);
+
+        fdput(file, put);
+        return (0 == n && bytes < 0) ? bytes : n;
 }
 
 /*
@@ -637,39 +930,17 @@ do_getdent(int fd, struct dirent *dirp)
 int
 do_lseek(int fd, int offset, int whence)
 {
-        if (fd == -1) {
-                dbg(DBG_PRINT, "(GRADING2B)\n");
-                return -EBADF;
-        }
-        file_t *file = fget(fd);
-        if (NULL == file) {
-                dbg(DBG_PRINT, "(GRADING2B)\n");
+        file_t *file;
+        int put, ret;
+
+        if (NULL == (file = fdget(fd, &put))) {
+                grading_dbg("(GRADING2B)\n");
                 return -EBADF;
         }
-        int newPos;
-        if (whence == SEEK_SET) {
-                newPos = offset;
-                dbg(DBG_PRINT, "(GRADING2B)\n");
-        } else if (whence == SEEK_CUR) {
-                newPos = file->f_pos + offset;
-                dbg(DBG_PRINT, "(GRADING2A)\n");
-        } else if (whence == SEEK_END) {
-                newPos = file->f_vnode->vn_len + offset;
-                dbg(DBG_PRINT, "(GRADING2A)\n");
-        } else {
-                fput(file);
-                dbg(DBG_PRINT, "(GRADING2B)\n");
-                return -EINVAL;
-        }
-        if (newPos < 0) {
-                fput(file);
-                dbg(DBG_PRINT, "(GRADING2B)\n");
-                return -EINVAL;
-        }
-        file->f_pos = newPos;
-        fput(file);
-        dbg(DBG_PRINT, "(GRADING2A)\n");
-        return newPos;
+        ret = file_lseek(file, offset, whence);
+        fdput(file, put);
+        grading_dbg("(GRADING2A)\n");
+        return ret;
 }
 
 /*
@@ -689,23 +960,23 @@ int
 do_stat(const char *path, struct stat *buf)
 {
         if (0 == strlen(path)) {
-                dbg(DBG_PRINT, "(GRADING2B)\n");
+                grading_dbg("(GRADING2B)\n");
                 return -EINVAL;
         }
         vnode_t *dir;
         int val = open_namev(path, 0, &dir, NULL);
         if (val < 0) {
-                dbg(DBG_PRINT, "(GRADING2B)\n");
+                grading_dbg("(GRADING2B)\n");
                 return val;
         }
 
         KASSERT(NULL != dir->vn_ops->stat); /* dir_vnode is the directory vnode where you will perform "stat" */
-        dbg(DBG_PRINT, "(GRADING2A 3.f)\n");
-        dbg(DBG_PRINT, "(GRADING2B)\n");
+        grading_dbg("(GRADING2A 3.f)\n");
+        grading_dbg("(GRADING2B)\n");
         /* please use TWO consecutive "conforming dbg() calls" for this since this function is not executed if you just start and stop weenix */
         val = dir->vn_ops->stat(dir, buf);
         vput(dir);
-        dbg(DBG_PRINT, "(GRADING2B)\n");
+        grading_dbg("(GRADING2B)\n");
         return val;
 }
 
@@ -729,8 +1000,47 @@ do_stat(const char *path, struct stat *buf)
 int
 do_mount(const char *source, const char *target, const char *type)
 {
-        NOT_YET_IMPLEMENTED("MOUNTING: do_mount");
-        return -EINVAL;
+        fs_t *fs;
+        vnode_t *mtpt;
+        int err;
+
+        if (strlen(source) >= sizeof(fs->fs_dev) || strlen(type) >= sizeof(fs->fs_type))
+                return -EINVAL;
+        if (NULL == (fs = kmalloc(sizeof(fs_t))))
+                return -ENOMEM;
+        memset(fs, 0, sizeof(fs_t));
+        strcpy(fs->fs_dev, source);
+        strcpy(fs->fs_type, type);
+
+        /* tmpfs needs no device, so it is set up here rather than through
+         * mountfunc's table of disk file systems */
+        if (!strcmp(type, "tmpfs"))
+                err = tmpfs_mount(fs);
+        else
+                err = mountfunc(fs);
+        if (err < 0) {
+                kfree(fs);
+                return err;
+        }
+
+        if ((err = open_namev(target, 0, &mtpt, NULL)) < 0)
+                goto fail;
+        if (!S_ISDIR(mtpt->vn_mode)) {
+                vput(mtpt);
+                err = -ENOTDIR;
+                goto fail;
+        }
+        /* vfs_mount takes over our reference to the mount point */
+        if ((err = vfs_mount(mtpt, fs)) < 0) {
+                vput(mtpt);
+                goto fail;
+        }
+        return 0;
+
+fail:
+        fs->fs_op->umount(fs);
+        kfree(fs);
+        return err;
 }
 
 /*
@@ -745,7 +1055,17 @@ do_mount(const char *source, const char *target, const char *type)
 int
 do_umount(const char *target)
 {
-        NOT_YET_IMPLEMENTED("MOUNTING: do_umount");
-        return -EINVAL;
+        vnode_t *vn;
+        fs_t *fs;
+        int err;
+
+        if ((err = open_namev(target, 0, &vn, NULL)) < 0)
+                return err;
+        fs = vn->vn_fs;
+        vput(vn);
+        /* looking up a mount point yields the root of what is mounted */
+        if (vn != fs->fs_root || fs == vfs_root_vn->vn_fs)
+                return -EINVAL;
+        return vfs_umount(fs);
 }
 #endif
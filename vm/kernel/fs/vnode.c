@@ -31,15 +31,54 @@
 #include "fs/stat.h"
 #include "fs/vfs.h"
 #include "fs/vnode.h"
+#include "fs/vnode_lru.h"
+#include "fs/dcache.h"
 #include "mm/slab.h"
 #include "proc/sched.h"
 #include "util/debug.h"
+#include "util/trace.h"
 #include "vm/vmmap.h"
 #include "globals.h"
 
 static slab_allocator_t *vnode_allocator;
+static slab_allocator_t *vnode_fs_allocator;
 
-static list_t vnode_inuse_list;
+/*
+ * In-use vnodes are found through a hash table keyed on (fs, vno) and
+ * chained through vn_link. Each file system also keeps a list of its own
+ * vnodes, so that walks like vfs_is_in_use only visit that file system.
+ *
+ * vnode_t has no room for the second link, so vnodes are allocated
+ * inside a vnode_ext_t; ve_vn must stay first.
+ */
+#define VNODE_HASH_SIZE 1024
+#define hash_vnode(fs, vno) \
+        (((((uint32_t)(fs)) >> 4) ^ ((uint32_t)(vno) * 2654435761u)) % VNODE_HASH_SIZE)
+
+typedef struct vnode_ext {
+        vnode_t         ve_vn;
+        list_link_t     ve_fslink;      /* link on vnode_fs_t vf_vnodes */
+        list_link_t     ve_lrulink;     /* link on vnode_lru, while inactive */
+} vnode_ext_t;
+
+typedef struct vnode_fs {
+        struct fs      *vf_fs;
+        list_t          vf_vnodes;      /* vnodes of this fs, via ve_fslink */
+        int             vf_count;       /* length of vf_vnodes */
+        int             vf_pinned;      /* don't free while someone walks vf_vnodes */
+        list_link_t     vf_link;        /* link on vnode_fs_list */
+} vnode_fs_t;
+
+static list_t vnode_hash[VNODE_HASH_SIZE];
+static list_t vnode_fs_list;
+
+/* Inactive vnodes (refcount 0, still linked), least recently used first */
+static list_t vnode_lru;
+static int vnode_lru_count = 0;
+int vnode_lru_max = __VNODE_LRU__;
+
+static void vnode_free(vnode_t *vn);
+static void vnode_unpin_pages(vnode_t *vn);
 
 /* Related to vnodes representing special files: */
 static void init_special_vnode(vnode_t *vn);
@@ -103,11 +142,74 @@ static vnode_ops_t blockdev_spec_vops = {
 static __attribute__((unused)) void
 vnode_init(void)
 {
-        list_init(&vnode_inuse_list);
-        vnode_allocator = slab_allocator_create("vnode", sizeof(vnode_t));
+        int i;
+        for (i = 0; i < VNODE_HASH_SIZE; ++i)
+                list_init(&vnode_hash[i]);
+        list_init(&vnode_fs_list);
+        list_init(&vnode_lru);
+        vnode_allocator = slab_allocator_create("vnode", sizeof(vnode_ext_t));
+        vnode_fs_allocator = slab_allocator_create("vnode_fs", sizeof(vnode_fs_t));
 }
 init_func(vnode_init);
 
+/* Returns the vnode list of fs, or NULL if it has no vnodes in use. */
+static vnode_fs_t *
+vnode_fs_lookup(struct fs *fs)
+{
+        vnode_fs_t *vf;
+        list_iterate_begin(&vnode_fs_list, vf, vnode_fs_t, vf_link) {
+                if (vf->vf_fs == fs)
+                        return vf;
+        } list_iterate_end();
+        return NULL;
+}
+
+static void
+vnode_fs_put(vnode_fs_t *vf)
+{
+        if (0 == vf->vf_count && 0 == vf->vf_pinned) {
+                list_remove(&vf->vf_link);
+                slab_obj_free(vnode_fs_allocator, vf);
+        }
+}
+
+static void
+vnode_lru_remove(vnode_t *vn)
+{
+        KASSERT(0 == vn->vn_refcount);
+        list_remove(&((vnode_ext_t *)vn)->ve_lrulink);
+        vnode_lru_count--;
+}
+
+int
+vnode_lru_shrink(int n)
+{
+        int evicted = 0;
+        while (evicted < n && !list_empty(&vnode_lru)) {
+                vnode_ext_t *ve = list_head(&vnode_lru, vnode_ext_t, ve_lrulink);
+                vnode_lru_remove(&ve->ve_vn);
+                vnode_free(&ve->ve_vn);
+                evicted++;
+        }
+        return evicted;
+}
+
+/* Evicts every inactive vnode of fs, so it can be unmounted. */
+static void
+vnode_lru_purge(struct fs *fs)
+{
+        vnode_ext_t *ve;
+again:
+        list_iterate_begin(&vnode_lru, ve, vnode_ext_t, ve_lrulink) {
+                if (ve->ve_vn.vn_fs == fs) {
+                        vnode_lru_remove(&ve->ve_vn);
+                        /* this can block, and the list can change under us */
+                        vnode_free(&ve->ve_vn);
+                        goto again;
+                }
+        } list_iterate_end();
+}
+
 /*
  * Core vnode management routines:
  */
@@ -125,12 +227,14 @@ vnode_t *
 vget(struct fs *fs, ino_t vno)
 {
         vnode_t *vn = NULL;
+        vnode_fs_t *vf;
+        list_t *bucket = &vnode_hash[hash_vnode(fs, vno)];
 
         KASSERT(fs);
 
         /* look for inuse vnode */
 find:
-        list_iterate_begin(&vnode_inuse_list, vn, vnode_t, vn_link) {
+        list_iterate_begin(bucket, vn, vnode_t, vn_link) {
                 if ((vn->vn_fs == fs) && (vn->vn_vno == vno)) {
                         /* found it... */
                         if (VN_BUSY & vn->vn_flags) {
@@ -145,6 +249,13 @@ find:
                                 goto find;
                         }
 
+                        if (0 == vn->vn_refcount) {
+                                /* inactive; take it back off the LRU */
+                                vnode_lru_remove(vn);
+                                vn->vn_refcount = 1;
+                                return vn;
+                        }
+
 #ifndef __MOUNTING__
                         /* If we are implementing mountpoint support
                            then we should get the mounted vnode,
@@ -161,9 +272,24 @@ find:
         } list_iterate_end();
 
         /* if we got here, we didn't find the vnode. */
+        if (NULL == (vf = vnode_fs_lookup(fs))) {
+                vf = slab_obj_alloc(vnode_fs_allocator);
+                if (!vf) {
+                        sched_make_runnable(curthr);
+                        sched_switch();
+                        goto find;
+                }
+                vf->vf_fs = fs;
+                list_init(&vf->vf_vnodes);
+                vf->vf_count = 0;
+                vf->vf_pinned = 0;
+                list_insert_tail(&vnode_fs_list, &vf->vf_link);
+        }
+
         /*   alloc a new vnode: */
         vn = slab_obj_alloc(vnode_allocator);
         if (!vn) {
+                vnode_fs_put(vf);
                 dbg(DBG_VNREF, "vget: kmem has been exhausted. "
                     "will then re-attempt to vget vnode later %d of fs %p\n", vno, fs);
                 sched_make_runnable(curthr);
@@ -187,14 +313,16 @@ find:
          *     vn_mode, vn_len, vn_i, and vn_devid (if
          *     appropriate)): */
 
-        /*       mark it busy and place it on vnode_inuse_list (so it can
+        /*       mark it busy and place it in the hash table (so it can
          *       be found while we are possibly blocking): (also, seems
          *       appropriate not to ref it yet since no references from
          *       outside this context (vnode.c) will exist until we are
          *       done bringing the vnode in)
          */
         vn->vn_flags |= VN_BUSY;
-        list_insert_head(&vnode_inuse_list, &vn->vn_link);
+        list_insert_head(bucket, &vn->vn_link);
+        list_insert_tail(&vf->vf_vnodes, &((vnode_ext_t *)vn)->ve_fslink);
+        vf->vf_count++;
 
         KASSERT(vn->vn_fs->fs_op && vn->vn_fs->fs_op->read_vnode);
         /*       this is where we might block (depending on the underlying
@@ -257,6 +385,7 @@ vput(struct vnode *vn)
                  * actively-referenced ever again, and thus there is no
                  * point in keeping it or any cached pages of it around.
                  */
+                vnode_unpin_pages(vn);
                 list_iterate_begin(&vn->vn_mmobj.mmo_respages, vp, pframe_t,
                                    pf_olink) {
                         /*  (dbounov):
@@ -286,7 +415,27 @@ vput(struct vnode *vn)
         KASSERT(vn->vn_mount == vn);
 #endif
 
-        /* no res pages and no more active references; free the vnode */
+        /* no res pages and no more active references */
+        KASSERT(0 == vn->vn_refcount);
+        KASSERT(0 == vn->vn_nrespages);
+
+        /* if it is still linked, it may well be wanted again soon: keep it
+         * on the inactive LRU rather than freeing it */
+        if (0 < vnode_lru_max && vn->vn_fs->fs_op->query_vnode(vn)) {
+                list_insert_tail(&vnode_lru, &((vnode_ext_t *)vn)->ve_lrulink);
+                vnode_lru_count++;
+                if (vnode_lru_count > vnode_lru_max)
+                        vnode_lru_shrink(vnode_lru_count - vnode_lru_max);
+                return;
+        }
+
+        vnode_free(vn);
+}
+
+/* Frees an unreferenced vnode, giving the fs a chance to write it back. */
+static void
+vnode_free(vnode_t *vn)
+{
         KASSERT(0 == vn->vn_refcount);
         KASSERT(0 == vn->vn_nrespages);
 
@@ -308,10 +457,31 @@ vput(struct vnode *vn)
          * we were taking it away: */
         sched_broadcast_on(&vn->vn_waitq);
 
-        list_remove(&vn->vn_link); /* remove from vn_inuse_list */
+        list_remove(&vn->vn_link); /* remove from vnode_hash */
+        list_remove(&((vnode_ext_t *)vn)->ve_fslink);
+        vnode_fs_t *vf = vnode_fs_lookup(vn->vn_fs);
+        KASSERT(NULL != vf);
+        vf->vf_count--;
+        vnode_fs_put(vf);
         slab_obj_free(vnode_allocator, vn);
 }
 
+/*
+ * File systems with no backing store (tmpfs) pin their pages, as anon
+ * objects do, so pageoutd cannot throw the data away. When a vnode's pages
+ * are being dropped for good there is no one else left to hold a pin, so
+ * those pins go first.
+ */
+static void
+vnode_unpin_pages(vnode_t *vn)
+{
+        pframe_t *pf;
+        list_iterate_begin(&vn->vn_mmobj.mmo_respages, pf, pframe_t, pf_olink) {
+                while (pframe_is_pinned(pf))
+                        pframe_unpin(pf);
+        } list_iterate_end();
+}
+
 int
 vfs_is_in_use(fs_t *fs)
 {
@@ -329,20 +499,20 @@ vfs_is_in_use(fs_t *fs)
          *             - return -EBUSY
          *
          */
-        list_t *list = &vnode_inuse_list;
-        list_link_t *link;
+        vnode_fs_t *vf = vnode_fs_lookup(fs);
+        vnode_ext_t *ve;
         int ret = 0;
-        for (link = list->l_next; link != list; link = link->l_next) {
-                vnode_t *vn = list_item(link, vnode_t, vn_link);
+
+        if (NULL == vf)
+                return 0;
+
+        list_iterate_begin(&vf->vf_vnodes, ve, vnode_ext_t, ve_fslink) {
+                vnode_t *vn = &ve->ve_vn;
                 int refs;
 
                 KASSERT(vn->vn_refcount >= vn->vn_nrespages);
                 KASSERT(vn->vn_nrespages >= 0);
-
-                if (fs != vn->vn_fs)
-                        continue;
-
-                /* otherwise, vn belongs to the given fs */
+                KASSERT(fs == vn->vn_fs);
 
                 /* if it is the root vnode and it has more than one
                  * reference
@@ -361,7 +531,7 @@ vfs_is_in_use(fs_t *fs)
                             (long)vn->vn_vno, vn->vn_mode, vn->vn_devid, vn->vn_flags, vn->vn_refcount, vn->vn_nrespages);
                         ret = -EBUSY;
                 }
-        }
+        } list_iterate_end();
 
         return ret;
 }
@@ -370,12 +540,26 @@ vfs_is_in_use(fs_t *fs)
 void
 vnode_flush_all(struct fs *fs)
 {
+        vnode_fs_t *vf = vnode_fs_lookup(fs);
+        vnode_ext_t *ve;
         vnode_t *v;
         pframe_t *p;
         int err;
 
+        dcache_purge_fs(fs);
+        if (NULL == vf)
+                return;
+        /* freeing pages can put the last vnode, which must not free vf
+         * out from under us */
+        vf->vf_pinned++;
+
+        list_iterate_begin(&vf->vf_vnodes, ve, vnode_ext_t, ve_fslink) {
+                vnode_unpin_pages(&ve->ve_vn);
+        } list_iterate_end();
+
 clean:
-        list_iterate_begin(&vnode_inuse_list, v, vnode_t, vn_link) {
+        list_iterate_begin(&vf->vf_vnodes, ve, vnode_ext_t, ve_fslink) {
+                v = &ve->ve_vn;
                 list_iterate_begin(&v->vn_mmobj.mmo_respages,
                                    p, pframe_t, pf_olink) {
                         if (pframe_is_dirty(p)) {
@@ -395,13 +579,21 @@ clean:
 
         /* all pages of all vnodes belonging to this fs have been cleaned.
          * Now, uncache all of them: */
-        list_iterate_begin(&vnode_inuse_list, v, vnode_t, vn_link) {
+        list_iterate_begin(&vf->vf_vnodes, ve, vnode_ext_t, ve_fslink) {
+                v = &ve->ve_vn;
                 list_iterate_begin(&v->vn_mmobj.mmo_respages,
                                    p, pframe_t, pf_olink) {
                         KASSERT(!pframe_is_dirty(p));
                         pframe_free(p);
                 } list_iterate_end();
         } list_iterate_end();
+
+        /* freeing the pages may have left vnodes inactive; those have to go
+         * too before the fs is unmounted */
+        vnode_lru_purge(fs);
+
+        vf->vf_pinned--;
+        vnode_fs_put(vf);
 }
 
 
@@ -411,14 +603,8 @@ clean:
 int
 vnode_inuse(struct fs *fs)
 {
-        vnode_t *vn;
-        int n = 0;
-
-        list_iterate_begin(&vnode_inuse_list, vn, vnode_t, vn_link) {
-                if (vn->vn_fs == fs)
-                        n++;
-        } list_iterate_end();
-        return n;
+        vnode_fs_t *vf = vnode_fs_lookup(fs);
+        return (NULL == vf) ? 0 : vf->vf_count;
 }
 
 static void
@@ -459,15 +645,15 @@ special_file_read(vnode_t *file, off_t offset, void *buf, size_t count)
 {
         KASSERT(file); /* the "file" argument must be a non-NULL vnode */
         KASSERT((S_ISCHR(file->vn_mode) || S_ISBLK(file->vn_mode))); /* the "file" argument must represent a character or a block device */
-        dbg(DBG_PRINT, "(GRADING2A 1.a)\n");
+        grading_dbg("(GRADING2A 1.a)\n");
 
         /*if (S_ISBLK(file->vn_mode)) {
                 return -ENOTSUP;
         }*/
 
         KASSERT(file->vn_cdev && file->vn_cdev->cd_ops && file->vn_cdev->cd_ops->read); /* make sure these points are non-null */
-        dbg(DBG_PRINT, "(GRADING2A 1.a)\n");
-        dbg(DBG_PRINT, "(GRADING2A)\n");
+        grading_dbg("(GRADING2A 1.a)\n");
+        grading_dbg("(GRADING2A)\n");
         
         return file->vn_cdev->cd_ops->read(file->vn_cdev, offset, buf, count); 
 }
@@ -483,15 +669,15 @@ special_file_write(vnode_t *file, off_t offset, const void *buf, size_t count)
 {
         KASSERT(file); /* the "file" argument must be a non-NULL vnode */
         KASSERT((S_ISCHR(file->vn_mode) || S_ISBLK(file->vn_mode))); /* the "file" argument must represent a character or a block device */
-        dbg(DBG_PRINT, "(GRADING2A 1.b)\n");
+        grading_dbg("(GRADING2A 1.b)\n");
 
         /*if (S_ISBLK(file->vn_mode)) {
                 return -ENOTSUP; 
         }*/
 
         KASSERT(file->vn_cdev && file->vn_cdev->cd_ops && file->vn_cdev->cd_ops->write); /* make sure these points are non-null */
-        dbg(DBG_PRINT, "(GRADING2A 1.b)\n");
-        dbg(DBG_PRINT, "(GRADING2A)\n");
+        grading_dbg("(GRADING2A 1.b)\n");
+        grading_dbg("(GRADING2A)\n");
 
         return file->vn_cdev->cd_ops->write(file->vn_cdev, offset, buf, count);
 }
@@ -506,7 +692,7 @@ special_file_write(vnode_t *file, off_t offset, const void *buf, size_t count)
 static int
 special_file_mmap(vnode_t *file, vmarea_t *vma, mmobj_t **ret)
 {
-        dbg(DBG_PRINT, "(GRADING3A)\n");
+        grading_dbg("(GRADING3A)\n");
         return file->vn_cdev->cd_ops->mmap(file, vma, ret);
 }
 /* Just as with mmap above, pass the call through to the
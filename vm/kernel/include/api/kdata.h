@@ -0,0 +1,58 @@
+/******************************************************************************/
+/* Important Spring 2020 CSCI 402 usage information:                          */
+/*                                                                            */
+/* This fils is part of CSCI 402 kernel programming assignments at USC.       */
+/*         53616c7465645f5fd1e93dbf35cbffa3aef28f8c01d8cf2ffc51ef62b26a       */
+/*         f9bda5a68e5ed8c972b17bab0f42e24b19daa7bd408305b1f7bd6c7208c1       */
+/*         0e36230e913039b3046dd5fd0ba706a624d33dbaa4d6aab02c82fe09f561       */
+/*         01b0fd977b0051f0b0ce0c69f7db857b1b5e007be2db6d42894bf93de848       */
+/*         806d9152bd5715e9                                                   */
+/* Please understand that you are NOT permitted to distribute or publically   */
+/*         display a copy of this file (or ANY PART of it) for any reason.    */
+/* If anyone (including your prospective employer) asks you to post the code, */
+/*         you must inform them that you do NOT have permissions to do so.    */
+/* You are also NOT permitted to remove or alter this comment block.          */
+/* If this comment block is removed or altered in a submitted file, 20 points */
+/*         will be deducted.                                                  */
+/******************************************************************************/
+
+#pragma once
+
+#include "types.h"
+#include "api/utsname.h"
+
+/*
+ * Layout of the kernel data page. Every process has one of these mapped
+ * read-only at KDATA_ADDR, so userland can answer getpid, uname and
+ * "how long since boot" without a system call. Userland needs a matching
+ * copy of this file.
+ *
+ * The monotonic clock is the processor's time-stamp counter, which user
+ * mode may read: subtract kd_tsc_boot from rdtsc to get cycles since boot.
+ */
+#define KDATA_ADDR      0x00400000      /* USER_MEM_LOW, below any ELF image */
+#define KDATA_MAGIC     0x4b444154      /* "KDAT" */
+
+typedef struct kdata {
+        uint32_t        kd_magic;
+        pid_t           kd_pid;
+        uint64_t        kd_tsc_boot;    /* time-stamp counter at boot */
+        struct utsname  kd_uname;
+} kdata_t;
+
+#define kdata_page()    ((const volatile kdata_t *)KDATA_ADDR)
+
+/* Library wrappers. These only touch the page, never trap. */
+static inline pid_t
+kdata_getpid(void)
+{
+        return kdata_page()->kd_pid;
+}
+
+static inline uint64_t
+kdata_uptime(void)
+{
+        uint32_t lo, hi;
+        __asm__ volatile("rdtsc" : "=a"(lo), "=d"(hi));
+        return (((uint64_t)hi << 32) | lo) - kdata_page()->kd_tsc_boot;
+}
@@ -0,0 +1,83 @@
+/******************************************************************************/
+/* Important Spring 2020 CSCI 402 usage information:                          */
+/*                                                                            */
+/* This fils is part of CSCI 402 kernel programming assignments at USC.       */
+/*         53616c7465645f5fd1e93dbf35cbffa3aef28f8c01d8cf2ffc51ef62b26a       */
+/*         f9bda5a68e5ed8c972b17bab0f42e24b19daa7bd408305b1f7bd6c7208c1       */
+/*         0e36230e913039b3046dd5fd0ba706a624d33dbaa4d6aab02c82fe09f561       */
+/*         01b0fd977b0051f0b0ce0c69f7db857b1b5e007be2db6d42894bf93de848       */
+/*         806d9152bd5715e9                                                   */
+/* Please understand that you are NOT permitted to distribute or publically   */
+/*         display a copy of this file (or ANY PART of it) for any reason.    */
+/* If anyone (including your prospective employer) asks you to post the code, */
+/*         you must inform them that you do NOT have permissions to do so.    */
+/* You are also NOT permitted to remove or alter this comment block.          */
+/* If this comment block is removed or altered in a submitted file, 20 points */
+/*         will be deducted.                                                  */
+/******************************************************************************/
+
+#pragma once
+
+#include "types.h"
+
+/*
+ * Submission/completion rings: a way to hand the kernel a batch of file
+ * operations with one trap. SYS_ring_setup maps a ring into the caller
+ * and returns its address; userland then fills in submission entries,
+ * advances rh_sq_tail and calls SYS_submit, which carries out the entries
+ * in order and posts one completion for each. Userland needs a matching
+ * copy of this file.
+ *
+ * All counters run freely and are reduced modulo the (power of two) ring
+ * size to index the arrays, so tail - head is the number of entries in a
+ * queue. Userland writes rh_sq_tail and rh_cq_head; the kernel writes
+ * rh_sq_head and rh_cq_tail. The completion queue is twice the size of
+ * the submission queue; SYS_submit stops early rather than overflow it.
+ */
+#define RING_MAGIC              0x52494e47      /* "RING" */
+#define RING_MAX_ENTRIES        256
+
+#define RING_OP_NOP             0
+#define RING_OP_READ            1       /* fd, addr, len */
+#define RING_OP_WRITE           2       /* fd, addr, len */
+#define RING_OP_OPEN            3       /* addr = path, len = strlen(path), flags */
+#define RING_OP_CLOSE           4       /* fd */
+#define RING_OP_STAT            5       /* addr = path, len = strlen(path), addr2 = struct stat */
+
+typedef struct ring_sqe {
+        uint32_t        sqe_op;
+        int             sqe_fd;
+        void           *sqe_addr;
+        size_t          sqe_len;
+        int             sqe_flags;
+        void           *sqe_addr2;
+        uint32_t        sqe_data;       /* handed back in the completion */
+        uint32_t        sqe_pad;
+} ring_sqe_t;
+
+typedef struct ring_cqe {
+        uint32_t        cqe_data;       /* sqe_data of the entry */
+        int             cqe_res;        /* what the syscall would return, or -errno */
+} ring_cqe_t;
+
+typedef struct ring_hdr {
+        uint32_t        rh_magic;
+        uint32_t        rh_sq_entries;
+        uint32_t        rh_cq_entries;
+        uint32_t        rh_sq_off;      /* byte offsets of the arrays */
+        uint32_t        rh_cq_off;
+        uint32_t        rh_sq_head;     /* written by the kernel */
+        uint32_t        rh_cq_tail;
+        uint32_t        rh_sq_tail;     /* written by userland */
+        uint32_t        rh_cq_head;
+} ring_hdr_t;
+
+#define ring_sqes(r)    ((ring_sqe_t *)((char *)(r) + (r)->rh_sq_off))
+#define ring_cqes(r)    ((ring_cqe_t *)((char *)(r) + (r)->rh_cq_off))
+
+/* Kernel side. Maps a ring with room for entries submissions into curproc */
+int do_ring_setup(uint32_t entries, void **ret);
+
+/* Carries out up to count entries of the ring at the user address ring.
+ * Returns the number consumed, or -errno if the ring is unusable. */
+int do_submit(ring_hdr_t *ring, uint32_t count);
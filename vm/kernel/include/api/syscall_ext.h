@@ -0,0 +1,65 @@
+/******************************************************************************/
+/* Important Spring 2020 CSCI 402 usage information:                          */
+/*                                                                            */
+/* This fils is part of CSCI 402 kernel programming assignments at USC.       */
+/*         53616c7465645f5fd1e93dbf35cbffa3aef28f8c01d8cf2ffc51ef62b26a       */
+/*         f9bda5a68e5ed8c972b17bab0f42e24b19daa7bd408305b1f7bd6c7208c1       */
+/*         0e36230e913039b3046dd5fd0ba706a624d33dbaa4d6aab02c82fe09f561       */
+/*         01b0fd977b0051f0b0ce0c69f7db857b1b5e007be2db6d42894bf93de848       */
+/*         806d9152bd5715e9                                                   */
+/* Please understand that you are NOT permitted to distribute or publically   */
+/*         display a copy of this file (or ANY PART of it) for any reason.    */
+/* If anyone (including your prospective employer) asks you to post the code, */
+/*         you must inform them that you do NOT have permissions to do so.    */
+/* You are also NOT permitted to remove or alter this comment block.          */
+/* If this comment block is removed or altered in a submitted file, 20 points */
+/*         will be deducted.                                                  */
+/******************************************************************************/
+
+#pragma once
+
+#include "types.h"
+
+struct iovec;
+struct ring_hdr;
+
+/*
+ * System calls added on top of the standard Weenix set. The numbers are
+ * kept well clear of the stock ones; userland needs a matching copy of
+ * this file.
+ */
+#define SYS_pread               100
+#define SYS_pwrite              101
+#define SYS_readv               102
+#define SYS_writev              103
+#define SYS_sendfile            104
+#define SYS_ring_setup          105     /* see api/ring.h */
+#define SYS_submit              106
+#define SYS_aio_read            107     /* takes a pio_args_t */
+#define SYS_aio_write           108
+#define SYS_aio_wait            109
+
+typedef struct pio_args {
+        int             fd;
+        void           *buf;
+        size_t          nbytes;
+        off_t           offset;
+} pio_args_t;
+
+typedef struct iov_args {
+        int                     fd;
+        const struct iovec     *iov;
+        int                     iovcnt;
+} iov_args_t;
+
+typedef struct sendfile_args {
+        int             out_fd;
+        int             in_fd;
+        off_t          *offset;         /* may be NULL */
+        size_t          count;
+} sendfile_args_t;
+
+typedef struct submit_args {
+        struct ring_hdr        *ring;
+        uint32_t                count;  /* entries to consume at most */
+} submit_args_t;
@@ -0,0 +1,63 @@
+/******************************************************************************/
+/* Important Spring 2020 CSCI 402 usage information:                          */
+/*                                                                            */
+/* This fils is part of CSCI 402 kernel programming assignments at USC.       */
+/*         53616c7465645f5fd1e93dbf35cbffa3aef28f8c01d8cf2ffc51ef62b26a       */
+/*         f9bda5a68e5ed8c972b17bab0f42e24b19daa7bd408305b1f7bd6c7208c1       */
+/*         0e36230e913039b3046dd5fd0ba706a624d33dbaa4d6aab02c82fe09f561       */
+/*         01b0fd977b0051f0b0ce0c69f7db857b1b5e007be2db6d42894bf93de848       */
+/*         806d9152bd5715e9                                                   */
+/* Please understand that you are NOT permitted to distribute or publically   */
+/*         display a copy of this file (or ANY PART of it) for any reason.    */
+/* If anyone (including your prospective employer) asks you to post the code, */
+/*         you must inform them that you do NOT have permissions to do so.    */
+/* You are also NOT permitted to remove or alter this comment block.          */
+/* If this comment block is removed or altered in a submitted file, 20 points */
+/*         will be deducted.                                                  */
+/******************************************************************************/
+
+#pragma once
+
+#include "types.h"
+
+struct proc;
+
+/*
+ * System call profiling. While syscall_stats_enabled is set, the syscall
+ * handler times every call with the TSC, from entry to syscall_dispatch
+ * until it returns (so time spent asleep inside the call is included).
+ * Each syscall number gets a call count, total cycles and a log2
+ * histogram: bucket i counts calls that took [2^i, 2^(i+1)) cycles.
+ * Each process also gets a count and total per syscall number, allocated
+ * the first time one of its calls is recorded.
+ *
+ * The numbers can be read with the "sysstat" kshell command, or as text
+ * from the byte device SYSCALL_STATS_DEVID (/dev/stats). Writing "on",
+ * "off" or "reset" to the device controls profiling.
+ */
+#define SYSCALL_STATS_NR        128     /* higher numbers share the last slot */
+#define SYSCALL_HIST_BUCKETS    32
+
+#define SYSCALL_STATS_DEVID     MKDEVID(3, 0)
+
+typedef struct syscall_stats {
+        uint32_t        st_count;
+        uint64_t        st_cycles;
+        uint32_t        st_hist[SYSCALL_HIST_BUCKETS];
+} syscall_stats_t;
+
+typedef struct proc_syscall_stats {
+        uint32_t        ps_count[SYSCALL_STATS_NR];
+        uint64_t        ps_cycles[SYSCALL_STATS_NR];
+} proc_syscall_stats_t;
+
+extern int syscall_stats_enabled;
+
+/* Each process's statistics, kept alongside its proc_t (see proc.c) */
+proc_syscall_stats_t **proc_syscall_stats(struct proc *p);
+
+/* Adds a call to sysnum by curproc that took cycles */
+void syscall_stats_record(uint32_t sysnum, uint64_t cycles);
+
+/* Registers the "sysstat" kshell command */
+void syscall_stats_kshell_init(void);
@@ -0,0 +1,45 @@
+/******************************************************************************/
+/* Important Spring 2020 CSCI 402 usage information:                          */
+/*                                                                            */
+/* This fils is part of CSCI 402 kernel programming assignments at USC.       */
+/*         53616c7465645f5fd1e93dbf35cbffa3aef28f8c01d8cf2ffc51ef62b26a       */
+/*         f9bda5a68e5ed8c972b17bab0f42e24b19daa7bd408305b1f7bd6c7208c1       */
+/*         0e36230e913039b3046dd5fd0ba706a624d33dbaa4d6aab02c82fe09f561       */
+/*         01b0fd977b0051f0b0ce0c69f7db857b1b5e007be2db6d42894bf93de848       */
+/*         806d9152bd5715e9                                                   */
+/* Please understand that you are NOT permitted to distribute or publically   */
+/*         display a copy of this file (or ANY PART of it) for any reason.    */
+/* If anyone (including your prospective employer) asks you to post the code, */
+/*         you must inform them that you do NOT have permissions to do so.    */
+/* You are also NOT permitted to remove or alter this comment block.          */
+/* If this comment block is removed or altered in a submitted file, 20 points */
+/*         will be deducted.                                                  */
+/******************************************************************************/
+
+#pragma once
+
+#include "types.h"
+
+struct pframe;
+
+/*
+ * Direct access to the current process's memory, for system calls that
+ * want to move data straight between a user buffer and another page
+ * (e.g. a file's page cache) instead of through a kernel bounce buffer.
+ *
+ * user_page_get finds the pframe backing uaddr, checks that the process
+ * may read it (or write it, if forwrite is set) and pins it. If forwrite
+ * is set the page is also dirtied and made private to the process, as
+ * for a write fault. The data for uaddr is then at
+ * pf_addr + PAGE_OFFSET(uaddr). Returns 0 or -errno (-EFAULT if uaddr
+ * is not mapped with the needed permission).
+ *
+ * user_page_put unpins it again.
+ */
+int user_page_get(const void *uaddr, int forwrite, struct pframe **result);
+void user_page_put(struct pframe *pf);
+
+/* Moves up to nbytes between fd and the user buffer ubuf a page at a time
+ * with user_page_get; read/write at f_pos if offset is NULL, otherwise
+ * pread/pwrite at *offset. Returns the bytes moved or -errno. */
+int user_file_io(int fd, void *ubuf, size_t nbytes, const off_t *offset, int iswrite);
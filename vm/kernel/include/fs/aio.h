@@ -0,0 +1,63 @@
+/******************************************************************************/
+/* Important Spring 2020 CSCI 402 usage information:                          */
+/*                                                                            */
+/* This fils is part of CSCI 402 kernel programming assignments at USC.       */
+/*         53616c7465645f5fd1e93dbf35cbffa3aef28f8c01d8cf2ffc51ef62b26a       */
+/*         f9bda5a68e5ed8c972b17bab0f42e24b19daa7bd408305b1f7bd6c7208c1       */
+/*         0e36230e913039b3046dd5fd0ba706a624d33dbaa4d6aab02c82fe09f561       */
+/*         01b0fd977b0051f0b0ce0c69f7db857b1b5e007be2db6d42894bf93de848       */
+/*         806d9152bd5715e9                                                   */
+/* Please understand that you are NOT permitted to distribute or publically   */
+/*         display a copy of this file (or ANY PART of it) for any reason.    */
+/* If anyone (including your prospective employer) asks you to post the code, */
+/*         you must inform them that you do NOT have permissions to do so.    */
+/* You are also NOT permitted to remove or alter this comment block.          */
+/* If this comment block is removed or altered in a submitted file, 20 points */
+/*         will be deducted.                                                  */
+/******************************************************************************/
+
+#pragma once
+
+#include "types.h"
+
+struct proc;
+
+/*
+ * Asynchronous file I/O. aio_read and aio_write queue a pread or pwrite
+ * for a pool of kernel worker threads and return a request id at once;
+ * aio_wait blocks until that request is done and returns what the pread
+ * or pwrite returned. A process can have several requests in flight, on
+ * the same or different files.
+ */
+
+/* Worker threads in the pool */
+#define AIO_NWORKERS            4
+
+/* Longest transfer one request will do; longer ones come back short */
+#define AIO_MAX_PAGES           16
+#define AIO_MAX_BYTES           (AIO_MAX_PAGES * PAGE_SIZE)
+
+/* Requests a process may have outstanding (submitted but not waited for) */
+#define AIO_MAX_REQUESTS        32
+
+/* Starts the worker threads. Called by idleproc once the VFS is up and
+ * its cwd is set, since new processes inherit it. */
+void aio_init(void);
+
+/* Queues nbytes of I/O between fd at offset and the user buffer ubuf.
+ * Returns a request id (> 0), or -errno: EBADF, EISDIR, EINVAL and
+ * ESPIPE (fd is not a regular file) as for pread/pwrite, EAGAIN if the
+ * process has too many requests outstanding, EFAULT, ENOMEM. */
+int do_aio_submit(int fd, void *ubuf, size_t nbytes, off_t offset, int iswrite);
+
+/* Waits for request id of the current process to finish and retires it.
+ * Returns its result, -EINVAL if there is no such request, or -EINTR if
+ * the wait was cancelled (the request stays outstanding). */
+int do_aio_wait(int id);
+
+/* Called as p exits: its requests are dropped, those still in progress
+ * once the worker is done with them */
+void aio_proc_exit(struct proc *p);
+
+/* Stops the worker threads, once the queue is empty */
+void aio_shutdown(void);
@@ -0,0 +1,59 @@
+/******************************************************************************/
+/* Important Spring 2020 CSCI 402 usage information:                          */
+/*                                                                            */
+/* This fils is part of CSCI 402 kernel programming assignments at USC.       */
+/*         53616c7465645f5fd1e93dbf35cbffa3aef28f8c01d8cf2ffc51ef62b26a       */
+/*         f9bda5a68e5ed8c972b17bab0f42e24b19daa7bd408305b1f7bd6c7208c1       */
+/*         0e36230e913039b3046dd5fd0ba706a624d33dbaa4d6aab02c82fe09f561       */
+/*         01b0fd977b0051f0b0ce0c69f7db857b1b5e007be2db6d42894bf93de848       */
+/*         806d9152bd5715e9                                                   */
+/* Please understand that you are NOT permitted to distribute or publically   */
+/*         display a copy of this file (or ANY PART of it) for any reason.    */
+/* If anyone (including your prospective employer) asks you to post the code, */
+/*         you must inform them that you do NOT have permissions to do so.    */
+/* You are also NOT permitted to remove or alter this comment block.          */
+/* If this comment block is removed or altered in a submitted file, 20 points */
+/*         will be deducted.                                                  */
+/******************************************************************************/
+
+#pragma once
+
+#include "types.h"
+
+struct vnode;
+struct fs;
+
+/*
+ * Directory entry cache. Maps (directory, name) to the (fs, vno) of the
+ * vnode the name refers to, so that lookup() can go straight to vget
+ * without asking the file system to scan the directory. Entries do not
+ * hold vnode references; they only remember inode numbers.
+ *
+ * Names known not to exist are cached too (negative entries), so probing
+ * for missing files does not scan the directory every time. Anything that
+ * adds a name to a directory must dcache_remove it first.
+ *
+ * Callers must hold the directory's lock (see fs/dirlock.h): shared for
+ * dcache_lookup and dcache_enter, exclusive for dcache_remove, so that a
+ * name cannot be removed between finding it and vget'ing it.
+ */
+
+/* Returned by dcache_lookup when it knows nothing about the name */
+#define DCACHE_MISS 1
+
+/* Returns 0 with a new reference in *result if the name is cached,
+ * -ENOENT if it is cached as missing, and DCACHE_MISS otherwise. */
+int dcache_lookup(struct vnode *dir, const char *name, size_t len,
+                  struct vnode **result);
+/* Records that name leads to vn, or, if vn is NULL, that it does not exist */
+void dcache_enter(struct vnode *dir, const char *name, size_t len,
+                  struct vnode *vn);
+void dcache_remove(struct vnode *dir, const char *name, size_t len);
+
+/* Drops every entry in directory dir (e.g. because it was removed) */
+void dcache_purge_dir(struct vnode *dir);
+/* Drops every entry belonging to fs, before it is unmounted */
+void dcache_purge_fs(struct fs *fs);
+
+/* Registers the "dcache" kshell command, which prints hit rates */
+void dcache_kshell_init(void);
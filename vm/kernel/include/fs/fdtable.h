@@ -0,0 +1,88 @@
+/******************************************************************************/
+/* Important Spring 2020 CSCI 402 usage information:                          */
+/*                                                                            */
+/* This fils is part of CSCI 402 kernel programming assignments at USC.       */
+/*         53616c7465645f5fd1e93dbf35cbffa3aef28f8c01d8cf2ffc51ef62b26a       */
+/*         f9bda5a68e5ed8c972b17bab0f42e24b19daa7bd408305b1f7bd6c7208c1       */
+/*         0e36230e913039b3046dd5fd0ba706a624d33dbaa4d6aab02c82fe09f561       */
+/*         01b0fd977b0051f0b0ce0c69f7db857b1b5e007be2db6d42894bf93de848       */
+/*         806d9152bd5715e9                                                   */
+/* Please understand that you are NOT permitted to distribute or publically   */
+/*         display a copy of this file (or ANY PART of it) for any reason.    */
+/* If anyone (including your prospective employer) asks you to post the code, */
+/*         you must inform them that you do NOT have permissions to do so.    */
+/* You are also NOT permitted to remove or alter this comment block.          */
+/* If this comment block is removed or altered in a submitted file, 20 points */
+/*         will be deducted.                                                  */
+/******************************************************************************/
+
+#pragma once
+
+#include "types.h"
+
+struct file;
+struct proc;
+
+/*
+ * Per-process file descriptor tables. A table starts with room for
+ * FDTABLE_MIN descriptors and doubles as needed, up to FDTABLE_MAX. Each
+ * in-use descriptor has a bit set in fdt_open, and each word of fdt_open
+ * that is completely full has a bit set in fdt_full, so the lowest free
+ * descriptor is found by looking at a couple of words rather than by
+ * scanning the table.
+ *
+ * fork does not copy the table: parent and child share it, and whichever
+ * of them first installs or removes a descriptor gets its own copy then.
+ */
+#define FDTABLE_MIN     ((NFILES + 31) & ~31)
+#define FDTABLE_MAX     8192
+
+typedef struct fdtable {
+        int             fdt_refcount;   /* processes sharing this table */
+        int             fdt_size;       /* descriptors there is room for */
+        int             fdt_count;      /* descriptors in use */
+        struct file   **fdt_files;
+        uint32_t       *fdt_open;       /* bit per descriptor in use */
+        uint32_t       *fdt_full;       /* bit per fdt_open word that is full */
+} fdtable_t;
+
+/* Sets up the table allocator; must run before proc_create */
+void fdtable_init(void);
+
+/* Each process's table, kept alongside its proc_t (see proc.c). It is
+ * NULL, meaning no descriptors, until fork shares one with it or
+ * fd_install first needs one. */
+fdtable_t **proc_fdtable(struct proc *p);
+
+/* Returns a new, empty table, or NULL if out of memory */
+fdtable_t *fdtable_create(void);
+
+/* Adds a process to those sharing fdt and returns it */
+fdtable_t *fdtable_share(fdtable_t *fdt);
+
+/* Nonzero if more than one process is using fdt */
+#define fdtable_shared(fdt)     (1 < (fdt)->fdt_refcount)
+
+/* Drops a process's use of fdt. The last user frees it, and must already
+ * have closed every descriptor. */
+void fdtable_put(fdtable_t *fdt);
+
+/* The file open on fd in p, or NULL. No reference is taken. */
+struct file *fd_lookup(struct proc *p, int fd);
+
+/* The lowest descriptor not in use in p, or -EMFILE */
+int fd_lowest_free(struct proc *p);
+
+/* Makes fd in p refer to file, growing the table (or unsharing it) if
+ * necessary; fd must not be in use. The table takes over the caller's
+ * reference. Returns 0, -EBADF if fd is out of range or -ENOMEM. */
+int fd_install(struct proc *p, int fd, struct file *file);
+
+/* Clears fd in p, unsharing the table if necessary, and returns the file
+ * it referred to in *filep (the reference now belongs to the caller).
+ * Returns 0, -EBADF if fd was not in use or -ENOMEM. */
+int fd_remove(struct proc *p, int fd, struct file **filep);
+
+/* The next descriptor in use in p at or after fd, or -1. For walking
+ * every open descriptor without visiting the empty ones. */
+int fd_next(struct proc *p, int fd);
@@ -0,0 +1,52 @@
+/******************************************************************************/
+/* Important Spring 2020 CSCI 402 usage information:                          */
+/*                                                                            */
+/* This fils is part of CSCI 402 kernel programming assignments at USC.       */
+/*         53616c7465645f5fd1e93dbf35cbffa3aef28f8c01d8cf2ffc51ef62b26a       */
+/*         f9bda5a68e5ed8c972b17bab0f42e24b19daa7bd408305b1f7bd6c7208c1       */
+/*         0e36230e913039b3046dd5fd0ba706a624d33dbaa4d6aab02c82fe09f561       */
+/*         01b0fd977b0051f0b0ce0c69f7db857b1b5e007be2db6d42894bf93de848       */
+/*         806d9152bd5715e9                                                   */
+/* Please understand that you are NOT permitted to distribute or publically   */
+/*         display a copy of this file (or ANY PART of it) for any reason.    */
+/* If anyone (including your prospective employer) asks you to post the code, */
+/*         you must inform them that you do NOT have permissions to do so.    */
+/* You are also NOT permitted to remove or alter this comment block.          */
+/* If this comment block is removed or altered in a submitted file, 20 points */
+/*         will be deducted.                                                  */
+/******************************************************************************/
+
+#pragma once
+
+#include "types.h"
+
+/*
+ * Scatter/gather, positional and batched I/O.
+ */
+
+/* Most iovecs a single readv/writev will take */
+#define IOV_MAX 16
+
+struct iovec {
+        void   *iov_base;
+        size_t  iov_len;
+};
+
+/* Like do_read/do_write, but at the given offset; f_pos is not used or
+ * changed. */
+int do_pread(int fd, void *buf, size_t nbytes, off_t offset);
+int do_pwrite(int fd, const void *buf, size_t nbytes, off_t offset);
+
+/* Like do_read/do_write, over each of the iovcnt (kernel) buffers in
+ * turn, stopping early at a short transfer. Returns the total number of
+ * bytes transferred. */
+int do_readv(int fd, const struct iovec *iov, int iovcnt);
+int do_writev(int fd, const struct iovec *iov, int iovcnt);
+
+/* Reads up to count directory entries from fd into dirp in one go.
+ * Returns the number read, 0 at the end of the directory, or -errno. */
+struct dirent;
+int do_getdents(int fd, struct dirent *dirp, int count);
+
+/* Copies from one file to another inside the kernel (see vfs_syscall.c) */
+int do_sendfile(int out_fd, int in_fd, off_t *offset, size_t count);
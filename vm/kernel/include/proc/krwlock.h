@@ -0,0 +1,50 @@
+/******************************************************************************/
+/* Important Spring 2020 CSCI 402 usage information:                          */
+/*                                                                            */
+/* This fils is part of CSCI 402 kernel programming assignments at USC.       */
+/*         53616c7465645f5fd1e93dbf35cbffa3aef28f8c01d8cf2ffc51ef62b26a       */
+/*         f9bda5a68e5ed8c972b17bab0f42e24b19daa7bd408305b1f7bd6c7208c1       */
+/*         0e36230e913039b3046dd5fd0ba706a624d33dbaa4d6aab02c82fe09f561       */
+/*         01b0fd977b0051f0b0ce0c69f7db857b1b5e007be2db6d42894bf93de848       */
+/*         806d9152bd5715e9                                                   */
+/* Please understand that you are NOT permitted to distribute or publically   */
+/*         display a copy of this file (or ANY PART of it) for any reason.    */
+/* If anyone (including your prospective employer) asks you to post the code, */
+/*         you must inform them that you do NOT have permissions to do so.    */
+/* You are also NOT permitted to remove or alter this comment block.          */
+/* If this comment block is removed or altered in a submitted file, 20 points */
+/*         will be deducted.                                                  */
+/******************************************************************************/
+
+#pragma once
+
+#include "proc/sched.h"
+
+struct kthread;
+
+/*
+ * A reader-writer lock. Any number of threads may hold the lock shared,
+ * or a single thread may hold it exclusive. Writers are preferred: once a
+ * writer is waiting, new readers block until it has had its turn, so a
+ * steady stream of readers cannot starve a writer.
+ *
+ * Like kmutex_t, a krwlock_t may only be taken and released from thread
+ * context, and is not recursive in either mode.
+ */
+typedef struct krwlock {
+        ktqueue_t       krw_rdq;        /* readers waiting for the lock */
+        ktqueue_t       krw_wrq;        /* writers waiting for the lock */
+        int             krw_readers;    /* number of threads holding it shared */
+        int             krw_wrwant;     /* writers waiting or woken but not yet owners */
+        struct kthread *krw_writer;     /* thread holding it exclusive, if any */
+} krwlock_t;
+
+void krwlock_init(krwlock_t *rw);
+
+void krwlock_rdlock(krwlock_t *rw);
+int  krwlock_rdlock_cancellable(krwlock_t *rw);
+void krwlock_rdunlock(krwlock_t *rw);
+
+void krwlock_wrlock(krwlock_t *rw);
+int  krwlock_wrlock_cancellable(krwlock_t *rw);
+void krwlock_wrunlock(krwlock_t *rw);
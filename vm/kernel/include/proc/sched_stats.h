@@ -0,0 +1,64 @@
+/******************************************************************************/
+/* Important Spring 2020 CSCI 402 usage information:                          */
+/*                                                                            */
+/* This fils is part of CSCI 402 kernel programming assignments at USC.       */
+/*         53616c7465645f5fd1e93dbf35cbffa3aef28f8c01d8cf2ffc51ef62b26a       */
+/*         f9bda5a68e5ed8c972b17bab0f42e24b19daa7bd408305b1f7bd6c7208c1       */
+/*         0e36230e913039b3046dd5fd0ba706a624d33dbaa4d6aab02c82fe09f561       */
+/*         01b0fd977b0051f0b0ce0c69f7db857b1b5e007be2db6d42894bf93de848       */
+/*         806d9152bd5715e9                                                   */
+/* Please understand that you are NOT permitted to distribute or publically   */
+/*         display a copy of this file (or ANY PART of it) for any reason.    */
+/* If anyone (including your prospective employer) asks you to post the code, */
+/*         you must inform them that you do NOT have permissions to do so.    */
+/* You are also NOT permitted to remove or alter this comment block.          */
+/* If this comment block is removed or altered in a submitted file, 20 points */
+/*         will be deducted.                                                  */
+/******************************************************************************/
+
+#pragma once
+
+#include "types.h"
+
+struct kthread;
+struct ktqueue;
+
+/*
+ * Scheduler latency statistics. Every thread is timestamped (with the
+ * TSC) as it moves between running, waiting on the run queue and
+ * sleeping on a wait queue, and each interval is added to a log2
+ * histogram: bucket i counts intervals of [2^i, 2^(i+1)) cycles.
+ */
+#define SCHED_HIST_BUCKETS 48
+
+typedef struct sched_hist {
+        uint32_t        sh_count[SCHED_HIST_BUCKETS];
+} sched_hist_t;
+
+/* What a thread's ss_stamp is currently measuring */
+#define SCHED_STATS_NONE        0       /* nothing (new or exited thread) */
+#define SCHED_STATS_RUNQ        1       /* time waiting on the run queue */
+#define SCHED_STATS_RUNNING     2       /* time on the CPU */
+#define SCHED_STATS_SLEEPING    3       /* time asleep on ss_wchan */
+
+typedef struct sched_stats {
+        uint64_t        ss_stamp;       /* TSC at the start of the current interval */
+        int             ss_where;       /* one of SCHED_STATS_* */
+        struct ktqueue *ss_wchan;       /* queue slept on, while SLEEPING */
+        sched_hist_t    ss_runq;        /* run queue wait per wakeup/yield */
+        sched_hist_t    ss_run;         /* time on the CPU per dispatch */
+        sched_hist_t    ss_sleep;       /* time asleep per sleep */
+} sched_stats_t;
+
+/* Per-thread statistics, kept alongside each kthread_t (see kthread.c) */
+sched_stats_t *kthread_sched_stats(struct kthread *thr);
+
+void sched_stats_init_thread(sched_stats_t *ss);
+
+/* Hooks called by the scheduler, with interrupts masked */
+void sched_stats_runnable(struct kthread *thr);
+void sched_stats_switch_out(struct kthread *oldthr);
+void sched_stats_switch_in(struct kthread *newthr);
+
+/* Registers the "schedstat" kshell command */
+void sched_stats_kshell_init(void);
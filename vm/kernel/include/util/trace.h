@@ -0,0 +1,68 @@
+/******************************************************************************/
+/* Important Spring 2020 CSCI 402 usage information:                          */
+/*                                                                            */
+/* This fils is part of CSCI 402 kernel programming assignments at USC.       */
+/*         53616c7465645f5fd1e93dbf35cbffa3aef28f8c01d8cf2ffc51ef62b26a       */
+/*         f9bda5a68e5ed8c972b17bab0f42e24b19daa7bd408305b1f7bd6c7208c1       */
+/*         0e36230e913039b3046dd5fd0ba706a624d33dbaa4d6aab02c82fe09f561       */
+/*         01b0fd977b0051f0b0ce0c69f7db857b1b5e007be2db6d42894bf93de848       */
+/*         806d9152bd5715e9                                                   */
+/* Please understand that you are NOT permitted to distribute or publically   */
+/*         display a copy of this file (or ANY PART of it) for any reason.    */
+/* If anyone (including your prospective employer) asks you to post the code, */
+/*         you must inform them that you do NOT have permissions to do so.    */
+/* You are also NOT permitted to remove or alter this comment block.          */
+/* If this comment block is removed or altered in a submitted file, 20 points */
+/*         will be deducted.                                                  */
+/******************************************************************************/
+
+#pragma once
+
+#include "types.h"
+#include "util/debug.h"
+
+/*
+ * The "(GRADING...)" self-check messages. With GRADING_TRACE=0 in
+ * Config.mk they are compiled out completely instead of costing a call
+ * and a mode check every time they are passed.
+ */
+#ifdef __GRADING_TRACE__
+#define grading_dbg(...) dbg(DBG_PRINT, __VA_ARGS__)
+#else
+#define grading_dbg(...) do { } while (0)
+#endif
+
+/*
+ * Trace points which are always compiled in but cost only a load and a
+ * not-taken branch until they are switched on at runtime, either from
+ * the debugger (trace_enabled[]) or with the "trace" kshell command.
+ *
+ * To add a key, add it to TRACE_KEYS; then trace(name, fmt, ...) prints
+ * fmt whenever the key is on, regardless of DBG.
+ */
+#define TRACE_KEYS(X)           \
+        X(sched)                \
+        X(kmutex)               \
+        X(pframe)               \
+        X(vmmap)                \
+        X(pagefault)
+
+#define TRACE_KEY_ENUM(name) TRACE_##name,
+enum {
+        TRACE_KEYS(TRACE_KEY_ENUM)
+        TRACE_NKEYS
+};
+#undef TRACE_KEY_ENUM
+
+extern uint8_t trace_enabled[TRACE_NKEYS];
+
+#define trace(key, ...)                                                 \
+        do {                                                            \
+                if (__builtin_expect(trace_enabled[TRACE_##key], 0)) {  \
+                        dbg_print("%s(): ", __func__);                  \
+                        dbg_print(__VA_ARGS__);                         \
+                }                                                       \
+        } while (0)
+
+/* Registers the "trace" kshell command */
+void trace_kshell_init(void);
@@ -0,0 +1,36 @@
+/******************************************************************************/
+/* Important Spring 2020 CSCI 402 usage information:                          */
+/*                                                                            */
+/* This fils is part of CSCI 402 kernel programming assignments at USC.       */
+/*         53616c7465645f5fd1e93dbf35cbffa3aef28f8c01d8cf2ffc51ef62b26a       */
+/*         f9bda5a68e5ed8c972b17bab0f42e24b19daa7bd408305b1f7bd6c7208c1       */
+/*         0e36230e913039b3046dd5fd0ba706a624d33dbaa4d6aab02c82fe09f561       */
+/*         01b0fd977b0051f0b0ce0c69f7db857b1b5e007be2db6d42894bf93de848       */
+/*         806d9152bd5715e9                                                   */
+/* Please understand that you are NOT permitted to distribute or publically   */
+/*         display a copy of this file (or ANY PART of it) for any reason.    */
+/* If anyone (including your prospective employer) asks you to post the code, */
+/*         you must inform them that you do NOT have permissions to do so.    */
+/* You are also NOT permitted to remove or alter this comment block.          */
+/* If this comment block is removed or altered in a submitted file, 20 points */
+/*         will be deducted.                                                  */
+/******************************************************************************/
+
+#pragma once
+
+struct vmmap;
+
+/*
+ * Address space locking. Lookups (page faults, copy_from_user and
+ * copy_to_user, permission checks) take the map shared; anything that
+ * adds, removes or resizes vmareas takes it exclusive.
+ *
+ * vmmap_map, vmmap_remove, vmmap_clone and vmmap_destroy lock the map
+ * themselves. vmmap_lookup, vmmap_insert, vmmap_is_range_empty and
+ * vmmap_find_range do not; callers that use them directly must hold the
+ * map's lock.
+ */
+void vmmap_rdlock(struct vmmap *map);
+void vmmap_rdunlock(struct vmmap *map);
+void vmmap_wrlock(struct vmmap *map);
+void vmmap_wrunlock(struct vmmap *map);
@@ -24,6 +24,7 @@
 #include "util/gdb.h"
 #include "util/init.h"
 #include "util/debug.h"
+#include "util/trace.h"
 #include "util/string.h"
 #include "util/printf.h"
 
@@ -45,6 +46,7 @@
 #include "proc/sched.h"
 #include "proc/proc.h"
 #include "proc/kthread.h"
+#include "proc/sched_stats.h"
 
 #include "drivers/dev.h"
 #include "drivers/blockdev.h"
@@ -54,10 +56,14 @@
 
 #include "api/exec.h"
 #include "api/syscall.h"
+#include "api/syscall_stats.h"
 
 #include "fs/vfs.h"
 #include "fs/vnode.h"
 #include "fs/vfs_syscall.h"
+#include "fs/dcache.h"
+#include "fs/aio.h"
+#include "fs/fdtable.h"
 #include "fs/fcntl.h"
 #include "fs/stat.h"
 
@@ -87,6 +93,13 @@ extern void *sunghan_deadlock_test(int arg1, void *arg2);
 extern void *vfstest_main(int arg1, void *arg2);
 extern int faber_fs_thread_test(kshell_t *ksh, int arg1, char **arg2);
 extern int faber_directory_test(kshell_t *ksh, int arg1, char **arg2);
+extern int namev_bench(kshell_t *ksh, int argc, char **argv);
+extern int pipe_bench(kshell_t *ksh, int argc, char **argv);
+extern int rw_bench(kshell_t *ksh, int argc, char **argv);
+extern int tmpfs_test(kshell_t *ksh, int argc, char **argv);
+
+extern void kthread_reapd_init(void);
+extern void kthread_reapd_shutdown(void);
 
 
 /**
@@ -124,6 +137,7 @@ kmain()
         shadow_init();
 #endif
         vmmap_init();
+        fdtable_init();
         proc_init();
         kthread_init();
 
@@ -196,11 +210,11 @@ bootstrap(int arg1, void *arg2)
         curproc = proc_create("Idleproc");
         KASSERT(NULL != curproc); /* curproc was uninitialized before, it is initialized here to point to the "idle" process */
         KASSERT(PID_IDLE == curproc->p_pid); /* make sure the process ID of the created "idle" process is PID_IDLE */
-        dbg(DBG_PRINT, "(GRADING1A 1.a)\n");
+        grading_dbg("(GRADING1A 1.a)\n");
         curthr = kthread_create(curproc, idleproc_run, 0, NULL);
         KASSERT(NULL != curthr); /* curthr was uninitialized before, it is initialized here to point to the thread of the "idle" process */
-        dbg(DBG_PRINT, "(GRADING1A 1.a)\n");
-        dbg(DBG_PRINT, "(GRADING1A)\n");
+        grading_dbg("(GRADING1A 1.a)\n");
+        grading_dbg("(GRADING1A)\n");
         context_make_active(&(curthr->kt_ctx));
 
         panic("weenix returned to bootstrap()!!! BAD!!!\n");
@@ -248,12 +262,24 @@ idleproc_run(int arg1, void *arg2)
         do_mknod("/dev/null", S_IFCHR, MEM_NULL_DEVID);
         do_mknod("/dev/zero", S_IFCHR, MEM_ZERO_DEVID);
         do_mknod("/dev/tty0", S_IFCHR, MKDEVID(2,0));
+        do_mknod("/dev/stats", S_IFCHR, SYSCALL_STATS_DEVID);
         // do_mknod("/dev/tty1", S_IFCHR, MKDEVID(2,1));
         // do_mknod("/dev/tty2", S_IFCHR, MKDEVID(2,2));
 
+#ifdef __MOUNTING__
+        /* scratch files stay off the disk */
+        do_mkdir("/tmp");
+        if (do_mount("", "/tmp", "tmpfs") < 0)
+                dbg(DBG_VFS, "could not mount tmpfs on /tmp\n");
+#endif
 
+        /* the workers inherit our cwd, so this has to wait until it is set */
+        aio_init();
 #endif
 
+        /* so does the reaper */
+        kthread_reapd_init();
+
         /* Finally, enable interrupts (we want to make sure interrupts
          * are enabled AFTER all drivers are initialized) */
         intr_enable();
@@ -264,9 +290,10 @@ idleproc_run(int arg1, void *arg2)
         child = do_waitpid(-1, 0, &status);
         KASSERT(PID_INIT == child);
 
-#ifdef __MTP__
-        kthread_reapd_shutdown();
+#ifdef __VFS__
+        aio_shutdown();
 #endif
+        kthread_reapd_shutdown();
 
 
 #ifdef __SHADOWD__
@@ -278,6 +305,9 @@ idleproc_run(int arg1, void *arg2)
         /* Shutdown the vfs: */
         dbg_print("weenix: vfs shutdown...\n");
         vput(curproc->p_cwd);
+#ifdef __MOUNTING__
+        do_umount("/tmp");
+#endif
         if (vfs_shutdown())
                 panic("vfs shutdown FAILED!!\n");
 
@@ -310,11 +340,14 @@ initproc_create(void)
         proc_t *p = proc_create("Initproc");
         KASSERT(NULL != p);
         KASSERT(PID_INIT == p->p_pid);
-        dbg(DBG_PRINT, "(GRADING1A 1.b)\n");
+        /* every user process inherits its descriptors from here */
+        *proc_fdtable(p) = fdtable_create();
+        KASSERT(NULL != *proc_fdtable(p));
+        grading_dbg("(GRADING1A 1.b)\n");
         kthread_t *thr = kthread_create(p, initproc_run, 0, NULL);
         KASSERT(NULL != thr);
-        dbg(DBG_PRINT, "(GRADING1A 1.b)\n");
-        dbg(DBG_PRINT, "(GRADING1A)\n");
+        grading_dbg("(GRADING1A 1.b)\n");
+        grading_dbg("(GRADING1A)\n");
         return thr;
 }
 
@@ -486,6 +519,23 @@ initproc_run(int arg1, void *arg2)
         if (NULL == kshell) panic("init: Couldn't create kernel shell\n");
         while (kshell_execute_next(kshell));
         kshell_destroy(kshell);*/
+        sched_stats_kshell_init();
+        syscall_stats_kshell_init();
+        trace_kshell_init();
+        dcache_kshell_init();
+        kshell_add_command("namevbench", namev_bench, "time path lookups: namevbench [depth [iterations]]");
+        kshell_add_command("pipebench", pipe_bench, "time a pipe transfer: pipebench [kilobytes [chunk]]");
+        kshell_add_command("rwbench", rw_bench, "time one-byte read/write syscalls: rwbench [iterations]");
+#ifdef __MOUNTING__
+        kshell_add_command("tmpfstest", tmpfs_test, "unmount a tmpfs with files left in it");
+#endif
+
+#ifdef __KSHELL__
+        kshell_t *kshell = kshell_create(0);
+        if (NULL == kshell) panic("init: Couldn't create kernel shell\n");
+        while (kshell_execute_next(kshell));
+        kshell_destroy(kshell);
+#endif
 
         do_open("dev/tty0", O_RDONLY);
         do_open("dev/tty0", O_WRONLY);
@@ -497,7 +547,7 @@ initproc_run(int arg1, void *arg2)
         kernel_execve("/sbin/init", argv, envp);
 
 #endif /*__DRIVERs__*/
-        dbg(DBG_PRINT, "(GRADING1A)\n");
+        grading_dbg("(GRADING1A)\n");
 
         return NULL;
 }
@@ -23,6 +23,7 @@
 #include "proc/proc.h"
 
 #include "util/debug.h"
+#include "util/trace.h"
 #include "util/string.h"
 
 #include "mm/mmobj.h"
@@ -35,6 +36,8 @@
 
 #include "vm/vmmap.h"
 
+#include "fs/vnode_lru.h"
+
 /*
  * In this file, physical pages (as represented by pframes) will be
  * referred to as "pages"
@@ -129,6 +132,8 @@ static void pageoutd_exit(void);
 #define pageoutd_needed()        \
         ((page_free_count() <= nfreepages_min) && (!list_empty(&alloc_list)))
 #define pageoutd_target_met()    (page_free_count() >= nfreepages_target)
+/* Inactive vnodes evicted each time pageoutd runs short of memory */
+#define PAGEOUTD_VNODE_BATCH     16
 
 
 /*
@@ -359,10 +364,11 @@ pframe_get(struct mmobj *o, uint32_t pagenum, pframe_t **result)
         pframe_t *pf;
         while ((pf = pframe_get_resident(o, pagenum)) != NULL && pframe_is_busy(pf)) {
                 sched_sleep_on(&pf->pf_waitq);
-                dbg(DBG_PRINT, "(GRADING3B 7)\n");
+                grading_dbg("(GRADING3B 7)\n");
         }
 
         if (NULL == pf) {
+                trace(pframe, "miss: obj 0x%p page %u\n", o, pagenum);
                 /*if (pageoutd_needed()) {
                         pageoutd_wakeup();
                 }*/
@@ -373,18 +379,18 @@ pframe_get(struct mmobj *o, uint32_t pagenum, pframe_t **result)
                 int val = pframe_fill(pf);
                 if (val < 0) {
                         pframe_free(pf);
-			dbg(DBG_PRINT, "(GRADING3D 2)\n");
+			grading_dbg("(GRADING3D 2)\n");
                         return val;
                 }
-                dbg(DBG_PRINT, "(GRADING3A)\n");
+                grading_dbg("(GRADING3A)\n");
         }
 
         *result = pf;
 
         KASSERT(NULL != *result); /* on successful return, must return a valid pframe object */
         KASSERT(!pframe_is_busy(*result)); /*  the returned pframe object must not be in the "busy" state */
-        dbg(DBG_PRINT, "(GRADING3A 1.a)\n");
-        dbg(DBG_PRINT, "(GRADING3A)\n");
+        grading_dbg("(GRADING3A 1.a)\n");
+        grading_dbg("(GRADING3A)\n");
         return 0;
 }
 
@@ -406,16 +412,16 @@ pframe_pin(pframe_t *pf)
 {
         KASSERT(!pframe_is_free(pf)); /* can only pin a pframe object that's "in-use" */
         KASSERT(pf->pf_pincount >= 0); /* the pin-count of a pframe object cannot be negative */
-        dbg(DBG_PRINT, "(GRADING3A 1.b)\n");
+        grading_dbg("(GRADING3A 1.b)\n");
 
         if (pf->pf_pincount++ == 0) {
                 list_remove(&pf->pf_link);
                 nallocated--;
                 list_insert_tail(&pinned_list, &pf->pf_link);
                 npinned++;
-                dbg(DBG_PRINT, "(GRADING3A)\n");
+                grading_dbg("(GRADING3A)\n");
         }
-        dbg(DBG_PRINT, "(GRADING3A)\n");
+        grading_dbg("(GRADING3A)\n");
 }
 
 /*
@@ -433,16 +439,16 @@ pframe_unpin(pframe_t *pf)
 {
         KASSERT(!pframe_is_free(pf)); /* can only pin a pframe object that's "in-use" */
         KASSERT(pf->pf_pincount > 0); /* the pin-count of a pframe object must be positive */
-        dbg(DBG_PRINT, "(GRADING3A 1.c)\n");
+        grading_dbg("(GRADING3A 1.c)\n");
 
         if (--pf->pf_pincount == 0) {
                 list_remove(&pf->pf_link);
                 npinned--;
                 list_insert_tail(&alloc_list, &pf->pf_link);
                 nallocated++;
-                dbg(DBG_PRINT, "(GRADING3A)\n");
+                grading_dbg("(GRADING3A)\n");
         }
-        dbg(DBG_PRINT, "(GRADING3A)\n");
+        grading_dbg("(GRADING3A)\n");
 }
 
 /*
@@ -670,6 +676,10 @@ pageoutd_run(int arg1, void *arg2)
 {
         while (1) {
                 KASSERT(nallocated >= 0);
+                /* inactive vnodes hold on to fs state (e.g. pinned inode
+                 * pages); let some go before reclaiming data pages */
+                if (!pageoutd_target_met())
+                        vnode_lru_shrink(PAGEOUTD_VNODE_BATCH);
                 while ((!pageoutd_target_met()) && (!list_empty(&alloc_list))) {
                         pframe_t *pf;
 
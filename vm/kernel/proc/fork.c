@@ -21,6 +21,7 @@
 #include "errno.h"
 
 #include "util/debug.h"
+#include "util/trace.h"
 #include "util/string.h"
 
 #include "proc/proc.h"
@@ -35,15 +36,20 @@
 #include "mm/tlb.h"
 
 #include "fs/file.h"
+#include "fs/fdtable.h"
 #include "fs/vnode.h"
 
 #include "vm/shadow.h"
 #include "vm/vmmap.h"
+#include "vm/vmmap_lock.h"
+#include "vm/kdata.h"
 
 #include "api/exec.h"
 
 #include "main/interrupt.h"
 
+void proc_discard(proc_t *p);
+
 /* Pushes the appropriate things onto the kernel stack of a newly forked thread
  * so that it can begin execution in userland_entry.
  * regs: registers the new thread should have on execution
@@ -73,7 +79,7 @@ do_fork(struct regs *regs)
     KASSERT(regs != NULL);	
     KASSERT(curproc != NULL);
     KASSERT(curproc->p_state == PROC_RUNNING);
-    dbg(DBG_PRINT, "(GRADING3A 7.a)\n");
+    grading_dbg("(GRADING3A 7.a)\n");
 
     vmarea_t *vma, *clone_vma;
     pframe_t *pf;
@@ -86,6 +92,7 @@ do_fork(struct regs *regs)
         curthr->kt_errno = ENOMEM;
         return -ENOMEM;
     }*/
+    vmmap_wrlock(parent_map);
     list_iterate_begin(&parent_map->vmm_list, vma, vmarea_t, vma_plink) {
         clone_vma = vmmap_lookup(clone_map, vma->vma_start);
         if(clone_vma->vma_flags & MAP_SHARED){
@@ -93,7 +100,7 @@ do_fork(struct regs *regs)
             clone_vma->vma_obj->mmo_ops->ref(clone_vma->vma_obj);
             //maybe
             list_insert_tail(&clone_vma->vma_obj->mmo_un.mmo_vmas, &clone_vma->vma_olink);
-            dbg(DBG_PRINT, "(GRADING3D 1)\n");
+            grading_dbg("(GRADING3D 1)\n");
         }else{
             mmobj_t *clone_shadow = shadow_create();
             mmobj_t *parent_shadow = shadow_create();
@@ -113,9 +120,10 @@ do_fork(struct regs *regs)
             vma->vma_obj = parent_shadow;
             
             list_insert_head(&bot->mmo_un.mmo_vmas, &clone_vma->vma_olink);
-            dbg(DBG_PRINT, "(GRADING3A)\n");
+            grading_dbg("(GRADING3A)\n");
         }
     } list_iterate_end();
+    vmmap_wrunlock(parent_map);
     
     // step 4
     tlb_flush_all();
@@ -131,7 +139,7 @@ do_fork(struct regs *regs)
     }*/
 
     KASSERT(clone_thr->kt_kstack != NULL);
-    dbg(DBG_PRINT, "(GRADING3A 7.a)\n");
+    grading_dbg("(GRADING3A 7.a)\n");
     
     // step 1, 7, proc need to be clean
     proc_t *clone_proc = proc_create("clone");
@@ -146,10 +154,16 @@ do_fork(struct regs *regs)
     clone_map->vmm_proc = clone_proc;
     clone_thr->kt_proc = clone_proc;
     list_insert_tail(&clone_proc->p_threads, &clone_thr->kt_plink);
+    // the kernel data page was shared above; the child needs its own pid
+    int err = kdata_map(clone_proc);
+    if (err < 0) {
+        proc_discard(clone_proc);
+        return err;
+    }
 
     KASSERT(clone_proc->p_state == PROC_RUNNING);  
     KASSERT(clone_proc->p_pagedir != NULL);  
-    dbg(DBG_PRINT, "(GRADING3A 7.a)\n");
+    grading_dbg("(GRADING3A 7.a)\n");
 
     // step 5
     clone_thr->kt_ctx.c_pdptr = clone_proc->p_pagedir;
@@ -161,14 +175,9 @@ do_fork(struct regs *regs)
     regs->r_eax = clone_proc->p_pid;
 
     // step 6
-    for(int i = 0; i < NFILES; i++) {
-        if(NULL != curproc->p_files[i]){
-            clone_proc->p_files[i] = curproc->p_files[i];
-            fref(clone_proc->p_files[i]);
-            dbg(DBG_PRINT, "(GRADING3A)\n");
-        }
-        dbg(DBG_PRINT, "(GRADING3A)\n");
-    }
+    // the child shares our table until one of us changes it
+    if (NULL != *proc_fdtable(curproc))
+        *proc_fdtable(clone_proc) = fdtable_share(*proc_fdtable(curproc));
     
     // step 9
     clone_proc->p_brk = curproc->p_brk;
@@ -176,6 +185,6 @@ do_fork(struct regs *regs)
     
     // step 10
     sched_make_runnable(clone_thr);
-    dbg(DBG_PRINT, "(GRADING3A)\n");
+    grading_dbg("(GRADING3A)\n");
     return clone_proc->p_pid;
 }
@@ -20,6 +20,7 @@
 #include "errno.h"
 
 #include "util/debug.h"
+#include "util/trace.h"
 
 #include "proc/kthread.h"
 #include "proc/kmutex.h"
@@ -35,7 +36,7 @@ kmutex_init(kmutex_t *mtx)
 {
         sched_queue_init(&mtx->km_waitq);
         mtx->km_holder = NULL;
-        dbg(DBG_PRINT, "(GRADING1A)\n");
+        grading_dbg("(GRADING1A)\n");
 }
 
 /*
@@ -48,14 +49,15 @@ void
 kmutex_lock(kmutex_t *mtx)
 {
         KASSERT(curthr && (curthr != mtx->km_holder));
-        dbg(DBG_PRINT, "(GRADING1A 6.a)\n");
+        grading_dbg("(GRADING1A 6.a)\n");
 
         if (mtx->km_holder != NULL) {
+                trace(kmutex, "0x%p contended, held by 0x%p\n", mtx, mtx->km_holder);
                 sched_sleep_on(&mtx->km_waitq);
-                dbg(DBG_PRINT, "(GRADING1C)\n");
+                grading_dbg("(GRADING1C)\n");
         }
         mtx->km_holder = curthr;
-        dbg(DBG_PRINT, "(GRADING1A)\n");
+        grading_dbg("(GRADING1A)\n");
     
 }
 
@@ -67,17 +69,17 @@ int
 kmutex_lock_cancellable(kmutex_t *mtx)
 {
         KASSERT(curthr && (curthr != mtx->km_holder));
-        dbg(DBG_PRINT, "(GRADING1A 6.b)\n");
-        dbg(DBG_PRINT, "(GRADING1C)\n");
+        grading_dbg("(GRADING1A 6.b)\n");
+        grading_dbg("(GRADING1C)\n");
 
         if (mtx->km_holder != NULL) {
                 if (sched_cancellable_sleep_on(&mtx->km_waitq) == -EINTR) {
-                        dbg(DBG_PRINT, "(GRADING1C)\n");
+                        grading_dbg("(GRADING1C)\n");
                         return -EINTR;
                 }
         }
         mtx->km_holder = curthr;
-        dbg(DBG_PRINT, "(GRADING1C)\n");
+        grading_dbg("(GRADING1C)\n");
         return 0;
 }
 
@@ -98,17 +100,17 @@ void
 kmutex_unlock(kmutex_t *mtx)
 {
         KASSERT(curthr && (curthr == mtx->km_holder));
-        dbg(DBG_PRINT, "(GRADING1A 6.c)\n");
+        grading_dbg("(GRADING1A 6.c)\n");
 
         if (sched_queue_empty(&mtx->km_waitq)) {
                 mtx->km_holder = 0;
-                dbg(DBG_PRINT, "(GRADING1A)\n");
+                grading_dbg("(GRADING1A)\n");
         } else {
                 mtx->km_holder = sched_wakeup_on(&mtx->km_waitq);
-                dbg(DBG_PRINT, "(GRADING1C)\n");
+                grading_dbg("(GRADING1C)\n");
         }
 
         KASSERT(curthr != mtx->km_holder);
-        dbg(DBG_PRINT, "(GRADING1A 6.c)\n");
-        dbg(DBG_PRINT, "(GRADING1A)\n");
+        grading_dbg("(GRADING1A 6.c)\n");
+        grading_dbg("(GRADING1A)\n");
 }
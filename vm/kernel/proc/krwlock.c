@@ -0,0 +1,157 @@
+/******************************************************************************/
+/* Important Spring 2020 CSCI 402 usage information:                          */
+/*                                                                            */
+/* This fils is part of CSCI 402 kernel programming assignments at USC.       */
+/*         53616c7465645f5fd1e93dbf35cbffa3aef28f8c01d8cf2ffc51ef62b26a       */
+/*         f9bda5a68e5ed8c972b17bab0f42e24b19daa7bd408305b1f7bd6c7208c1       */
+/*         0e36230e913039b3046dd5fd0ba706a624d33dbaa4d6aab02c82fe09f561       */
+/*         01b0fd977b0051f0b0ce0c69f7db857b1b5e007be2db6d42894bf93de848       */
+/*         806d9152bd5715e9                                                   */
+/* Please understand that you are NOT permitted to distribute or publically   */
+/*         display a copy of this file (or ANY PART of it) for any reason.    */
+/* If anyone (including your prospective employer) asks you to post the code, */
+/*         you must inform them that you do NOT have permissions to do so.    */
+/* You are also NOT permitted to remove or alter this comment block.          */
+/* If this comment block is removed or altered in a submitted file, 20 points */
+/*         will be deducted.                                                  */
+/******************************************************************************/
+
+#include "globals.h"
+#include "errno.h"
+
+#include "util/debug.h"
+
+#include "proc/kthread.h"
+#include "proc/sched.h"
+#include "proc/krwlock.h"
+
+/*
+ * As with mutexes, reader-writer locks can _NEVER_ be taken or released
+ * from an interrupt context.
+ *
+ * Unlike kmutex_unlock, releasing a krwlock_t does not hand the lock to
+ * the thread it wakes up. Woken threads re-check the lock state and go
+ * back to sleep if they lost a race, which is what lets a cancelled
+ * waiter simply walk away without having to give anything back.
+ */
+
+void
+krwlock_init(krwlock_t *rw)
+{
+        sched_queue_init(&rw->krw_rdq);
+        sched_queue_init(&rw->krw_wrq);
+        rw->krw_readers = 0;
+        rw->krw_wrwant = 0;
+        rw->krw_writer = NULL;
+}
+
+/*
+ * Called whenever the lock may have become available. If a writer is
+ * waiting it gets the next turn (but only once all readers are gone);
+ * otherwise every waiting reader is let in at once.
+ */
+static void
+krwlock_wakeup(krwlock_t *rw)
+{
+        if (NULL != rw->krw_writer)
+                return;
+
+        if (0 < rw->krw_wrwant) {
+                if (0 == rw->krw_readers)
+                        sched_wakeup_on(&rw->krw_wrq);
+        } else {
+                sched_broadcast_on(&rw->krw_rdq);
+        }
+}
+
+/*
+ * Take the lock shared. Blocks while a writer holds the lock or is
+ * waiting for it.
+ */
+void
+krwlock_rdlock(krwlock_t *rw)
+{
+        KASSERT(curthr && (curthr != rw->krw_writer));
+
+        while (NULL != rw->krw_writer || 0 < rw->krw_wrwant)
+                sched_sleep_on(&rw->krw_rdq);
+        rw->krw_readers++;
+}
+
+/*
+ * Same as krwlock_rdlock, but the sleep can be cancelled, in which case
+ * -EINTR is returned and the lock is not held.
+ */
+int
+krwlock_rdlock_cancellable(krwlock_t *rw)
+{
+        KASSERT(curthr && (curthr != rw->krw_writer));
+
+        while (NULL != rw->krw_writer || 0 < rw->krw_wrwant) {
+                if (-EINTR == sched_cancellable_sleep_on(&rw->krw_rdq))
+                        return -EINTR;
+        }
+        rw->krw_readers++;
+        return 0;
+}
+
+void
+krwlock_rdunlock(krwlock_t *rw)
+{
+        KASSERT(curthr && (curthr != rw->krw_writer));
+        KASSERT(0 < rw->krw_readers);
+
+        if (0 == --rw->krw_readers)
+                krwlock_wakeup(rw);
+}
+
+/*
+ * Take the lock exclusive. Blocks until there are no readers and no
+ * other writer.
+ */
+void
+krwlock_wrlock(krwlock_t *rw)
+{
+        KASSERT(curthr && (curthr != rw->krw_writer));
+
+        rw->krw_wrwant++;
+        while (NULL != rw->krw_writer || 0 < rw->krw_readers)
+                sched_sleep_on(&rw->krw_wrq);
+        rw->krw_wrwant--;
+        rw->krw_writer = curthr;
+}
+
+/*
+ * Same as krwlock_wrlock, but the sleep can be cancelled, in which case
+ * -EINTR is returned and the lock is not held. We may have been the
+ * writer chosen by the last wakeup, so pass that wakeup on before
+ * leaving; if we were the last waiting writer this also releases any
+ * readers that were held back on our account.
+ */
+int
+krwlock_wrlock_cancellable(krwlock_t *rw)
+{
+        KASSERT(curthr && (curthr != rw->krw_writer));
+
+        rw->krw_wrwant++;
+        while (NULL != rw->krw_writer || 0 < rw->krw_readers) {
+                if (-EINTR == sched_cancellable_sleep_on(&rw->krw_wrq)) {
+                        rw->krw_wrwant--;
+                        krwlock_wakeup(rw);
+                        return -EINTR;
+                }
+        }
+        rw->krw_wrwant--;
+        rw->krw_writer = curthr;
+        return 0;
+}
+
+void
+krwlock_wrunlock(krwlock_t *rw)
+{
+        KASSERT(curthr && (curthr == rw->krw_writer));
+        KASSERT(0 == rw->krw_readers);
+
+        rw->krw_writer = NULL;
+        krwlock_wakeup(rw);
+}
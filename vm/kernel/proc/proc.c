@@ -22,6 +22,7 @@
 #include "errno.h"
 
 #include "util/debug.h"
+#include "util/trace.h"
 #include "util/list.h"
 #include "util/string.h"
 #include "util/printf.h"
@@ -32,6 +33,7 @@
 #include "proc/proc.h"
 
 #include "mm/slab.h"
+#include "mm/kmalloc.h"
 #include "mm/page.h"
 #include "mm/mmobj.h"
 #include "mm/mm.h"
@@ -43,6 +45,22 @@
 #include "fs/vfs_syscall.h"
 #include "fs/vnode.h"
 #include "fs/file.h"
+#include "fs/fdtable.h"
+#include "fs/aio.h"
+
+#include "api/syscall_stats.h"
+
+/*
+ * Processes are allocated with their file descriptor table pointer and
+ * syscall statistics tacked on after the proc_t; pe_proc must stay first
+ * so a proc_t * can be cast back. The fixed p_files[] array in proc_t is
+ * no longer used.
+ */
+typedef struct proc_ext {
+        proc_t                  pe_proc;
+        fdtable_t              *pe_files;       /* replaces the fixed p_files[] */
+        proc_syscall_stats_t   *pe_syscalls;    /* NULL until a call is profiled */
+} proc_ext_t;
 
 proc_t *curproc = NULL; /* global */
 static slab_allocator_t *proc_allocator = NULL;
@@ -50,14 +68,33 @@ static slab_allocator_t *proc_allocator = NULL;
 static list_t _proc_list;
 static proc_t *proc_initproc = NULL; /* Pointer to the init process (PID 1) */
 
+/* An exiting process whose address space spans more than this many pages
+ * leaves it for the reaper to destroy rather than tearing it down before
+ * waking its parent. */
+#define PROC_REAP_VMMAP_PAGES 64
+
+int kthread_reapd_enqueue(proc_t *p);
+
 void
 proc_init()
 {
         list_init(&_proc_list);
-        proc_allocator = slab_allocator_create("proc", sizeof(proc_t));
+        proc_allocator = slab_allocator_create("proc", sizeof(proc_ext_t));
         KASSERT(proc_allocator != NULL);
 }
 
+fdtable_t **
+proc_fdtable(proc_t *p)
+{
+        return &((proc_ext_t *)p)->pe_files;
+}
+
+proc_syscall_stats_t **
+proc_syscall_stats(proc_t *p)
+{
+        return &((proc_ext_t *)p)->pe_syscalls;
+}
+
 proc_t *
 proc_lookup(int pid)
 {
@@ -225,11 +262,11 @@ proc_create(char *name)
         p->p_pid = _proc_getid();
         KASSERT(PID_IDLE != p->p_pid || list_empty(&_proc_list)); /* pid can only be PID_IDLE if this is the first process */
         KASSERT(PID_INIT != p->p_pid || PID_IDLE == curproc->p_pid); /* pid can only be PID_INIT if the running process is the "idle" process */
-        dbg(DBG_PRINT, "(GRADING1A 2.a)\n");
+        grading_dbg("(GRADING1A 2.a)\n");
         int len = strlen(name);
 	if (len >= PROC_NAME_LEN) {
                 len = PROC_NAME_LEN - 1;
-                dbg(DBG_PRINT, "(GRADING1E)\n");
+                grading_dbg("(GRADING1E)\n");
         }
         strncpy(p->p_comm, name, len);
         p->p_comm[len] = '\0';
@@ -238,10 +275,10 @@ proc_create(char *name)
         list_init(&(p->p_children));
         if (p->p_pid != 0) {
                 p->p_pproc = curproc;
-                dbg(DBG_PRINT, "(GRADING1A)\n");
+                grading_dbg("(GRADING1A)\n");
         } else {
                 p->p_pproc = NULL;
-                dbg(DBG_PRINT, "(GRADING1A)\n");
+                grading_dbg("(GRADING1A)\n");
         }
         p->p_status = 0; // ???
         p->p_state = PROC_RUNNING;
@@ -252,28 +289,28 @@ proc_create(char *name)
         list_init(&(p->p_child_link));
         if (NULL != curproc) {
                 list_insert_tail(&(curproc->p_children), &(p->p_child_link));
-                dbg(DBG_PRINT, "(GRADING1A)\n");
+                grading_dbg("(GRADING1A)\n");
         }
         if (p->p_pid == 1) {
                 proc_initproc = p;
-                dbg(DBG_PRINT, "(GRADING1A)\n");
+                grading_dbg("(GRADING1A)\n");
         }
 
-        for (int i = 0; i < NFILES; i++) {
-                p->p_files[i] = NULL;
-                dbg(DBG_PRINT, "(GRADING2A)\n");
-        }
+        /* fork shares its parent's table and initproc makes its own;
+         * anything else gets one when it first installs a descriptor */
+        *proc_fdtable(p) = NULL;
+        *proc_syscall_stats(p) = NULL;
         p->p_cwd = NULL;
         if (p->p_pid > 2) {
                 p->p_cwd = curproc->p_cwd;
                 vref(p->p_cwd);
-                dbg(DBG_PRINT, "(GRADING2B)\n");
+                grading_dbg("(GRADING2B)\n");
         }
 
         p->p_vmmap = vmmap_create();
         p->p_vmmap->vmm_proc = p;
 
-        dbg(DBG_PRINT, "(GRADING1A)\n");
+        grading_dbg("(GRADING1A)\n");
         return p;
 }
 
@@ -307,16 +344,30 @@ proc_cleanup(int status)
         KASSERT(NULL != proc_initproc); /* "init" process must exist and proc_initproc initialized */
         KASSERT(1 <= curproc->p_pid); /* this process must not be "idle" process */
         KASSERT(NULL != curproc->p_pproc); /* this process must have a parent when this function is entered */
-        dbg(DBG_PRINT, "(GRADING1A 2.b)\n");
+        grading_dbg("(GRADING1A 2.b)\n");
+
+        uint32_t npages = 0;
+        vmarea_t *vma;
+        list_iterate_begin(&curproc->p_vmmap->vmm_list, vma, vmarea_t, vma_plink) {
+                npages += vma->vma_end - vma->vma_start;
+        } list_iterate_end();
+        if (npages <= PROC_REAP_VMMAP_PAGES) {
+                vmmap_destroy(curproc->p_vmmap);
+                curproc->p_vmmap = NULL;
+        }
 
-        vmmap_destroy(curproc->p_vmmap);
+        aio_proc_exit(curproc);
 
-        for (int i = 0; i < NFILES; i++) {
-                if (NULL != curproc->p_files[i]) {
-                         do_close(i);
-                         dbg(DBG_PRINT, "(GRADING2D)\n");
+        /* a table still shared with another process keeps its files */
+        if (NULL != *proc_fdtable(curproc)) {
+                if (!fdtable_shared(*proc_fdtable(curproc))) {
+                        for (int i = fd_next(curproc, 0); i >= 0; i = fd_next(curproc, i + 1)) {
+                                do_close(i);
+                                grading_dbg("(GRADING2D)\n");
+                        }
                 }
-                dbg(DBG_PRINT, "(GRADING2A)\n");
+                fdtable_put(*proc_fdtable(curproc));
+                *proc_fdtable(curproc) = NULL;
         }
         if (curproc->p_cwd) {
                 vput(curproc->p_cwd);
@@ -329,9 +380,9 @@ proc_cleanup(int status)
                         list_remove(&(p->p_child_link));
                         list_insert_tail(&(proc_initproc->p_children), &(p->p_child_link));
                         p->p_pproc = proc_initproc;
-                        dbg(DBG_PRINT, "(GRADING1C)\n");
+                        grading_dbg("(GRADING1C)\n");
                 } list_iterate_end();
-                dbg(DBG_PRINT, "(GRADING1C)\n");
+                grading_dbg("(GRADING1C)\n");
         }
         curproc->p_status = status;
         curproc->p_state = PROC_DEAD;
@@ -339,9 +390,9 @@ proc_cleanup(int status)
 
         KASSERT(NULL != curproc->p_pproc); /* this process must still have a parent when this function returns */
         KASSERT(KT_EXITED == curthr->kt_state); /* the thread in this process should be in the KT_EXITED state when this function returns */
-        dbg(DBG_PRINT, "(GRADING1A 2.b)\n");
+        grading_dbg("(GRADING1A 2.b)\n");
 
-        dbg(DBG_PRINT, "(GRADING1A)\n");
+        grading_dbg("(GRADING1A)\n");
 }
 
 /*
@@ -356,18 +407,18 @@ void
 proc_kill(proc_t *p, int status)
 {
         if (p == curproc) {
-                dbg(DBG_PRINT, "(GRADING1C)\n");
+                grading_dbg("(GRADING1C)\n");
                 do_exit(status);
                 panic("Should never get here!\n");
         } else {
                 kthread_t *thr;
                 list_iterate_begin(&(p->p_threads), thr, kthread_t, kt_plink) {
                         kthread_cancel(thr, (void *)status); // ??? type cast
-                        dbg(DBG_PRINT, "(GRADING1C)\n");
+                        grading_dbg("(GRADING1C)\n");
                 } list_iterate_end();
-                dbg(DBG_PRINT, "(GRADING1C)\n");
+                grading_dbg("(GRADING1C)\n");
         }
-        dbg(DBG_PRINT, "(GRADING1C)\n");
+        grading_dbg("(GRADING1C)\n");
 }
 
 /*
@@ -382,18 +433,18 @@ proc_kill_all()
         proc_t *p;
         list_iterate_begin(proc_list(), p, proc_t, p_list_link) {
                 if (p != curproc && p->p_pid != PID_IDLE && p->p_pproc->p_pid != PID_IDLE) {
-                        dbg(DBG_PRINT, "(GRADING1C)\n");
+                        grading_dbg("(GRADING1C)\n");
                         proc_kill(p, -1); // ??? what should the status be?
                 }
-                dbg(DBG_PRINT, "(GRADING1C)\n");
+                grading_dbg("(GRADING1C)\n");
         } list_iterate_end();
 
         if (curproc->p_pid != PID_IDLE && curproc->p_pproc->p_pid != PID_IDLE) {
-                dbg(DBG_PRINT, "(GRADING1C)\n");
+                grading_dbg("(GRADING1C)\n");
                 proc_kill(curproc, -1); // ??? what should the status be?
                 panic("Should never get here!\n");
         }
-        dbg(DBG_PRINT, "(GRADING1E)\n");
+        grading_dbg("(GRADING1E)\n");
 
 }
 
@@ -409,7 +460,7 @@ void
 proc_thread_exited(void *retval)
 {
         proc_cleanup(curproc->p_status); // ??? check cast type
-        dbg(DBG_PRINT, "(GRADING1A)\n");
+        grading_dbg("(GRADING1A)\n");
         sched_switch();
         panic("Should never get here!\n");
 }
@@ -435,7 +486,7 @@ do_waitpid(pid_t pid, int options, int *status)
         KASSERT((pid > 0 || pid == -1) && options == 0);
 
         if (list_empty(&(curproc->p_children))) {
-                dbg(DBG_PRINT, "(GRADING1C)\n");
+                grading_dbg("(GRADING1C)\n");
                 return -ECHILD;
         }
 
@@ -446,55 +497,104 @@ do_waitpid(pid_t pid, int options, int *status)
                         list_iterate_begin(&(curproc->p_children), p, proc_t, p_child_link) {
                                 if (p->p_state == PROC_DEAD) {
                                         pid = p->p_pid;
-                                        dbg(DBG_PRINT, "(GRADING1A)\n");
+                                        grading_dbg("(GRADING1A)\n");
                                         goto destroy_thread;
                                 }
-                                dbg(DBG_PRINT, "(GRADING1A)\n");
+                                grading_dbg("(GRADING1A)\n");
                         } list_iterate_end();
                         sched_sleep_on(&(curproc->p_wait));
-                        dbg(DBG_PRINT, "(GRADING1A)\n");
+                        grading_dbg("(GRADING1A)\n");
                 }
         } else {
                 list_iterate_begin(&(curproc->p_children), p, proc_t, p_child_link) {
                         if (pid == p->p_pid) {
                                 found = 1;
-                                dbg(DBG_PRINT, "(GRADING1C)\n");
+                                grading_dbg("(GRADING1C)\n");
                                 goto found;
                         }
-                        dbg(DBG_PRINT, "(GRADING1C)\n");
+                        grading_dbg("(GRADING1C)\n");
                 } list_iterate_end();
 found:
                 if (!found) {
-                        dbg(DBG_PRINT, "(GRADING1C)\n");
+                        grading_dbg("(GRADING1C)\n");
                         return -ECHILD;
                 }
                 while (p->p_state != PROC_DEAD) {
                         sched_sleep_on(&(curproc->p_wait));
-                        dbg(DBG_PRINT, "(GRADING1C)\n");
+                        grading_dbg("(GRADING1C)\n");
                 }
-                dbg(DBG_PRINT, "(GRADING1C)\n");
+                grading_dbg("(GRADING1C)\n");
         }
 destroy_thread:
         KASSERT(NULL != p); /* must have found a dead child process */
         KASSERT(-1 == pid || p->p_pid == pid); /* if the pid argument is not -1, then pid must be the process ID of the found dead child process */
         KASSERT(NULL != p->p_pagedir); /* this process should have a valid pagedir before you destroy it */
-        dbg(DBG_PRINT, "(GRADING1A 2.c)\n");
+        grading_dbg("(GRADING1A 2.c)\n");
         if (status) {
                 *status = p->p_status;
         }
+        // list_remove(&(p->p_list_link));
+        list_remove(&(p->p_child_link));
+        if (kthread_reapd_enqueue(p) < 0) {
+                proc_destroy(p);
+        }
+
+        grading_dbg("(GRADING1A)\n");
+        return pid;
+}
+
+/*
+ * Frees everything a dead process still owns: its threads (and their
+ * stacks), its address space if proc_cleanup left it behind, its page
+ * directory, and the proc_t itself. Normally called by the reaper daemon;
+ * do_waitpid calls it directly when there is no reaper.
+ */
+void
+proc_destroy(proc_t *p)
+{
+        KASSERT(PROC_DEAD == p->p_state);
+
         kthread_t *thr;
         list_iterate_begin(&(p->p_threads), thr, kthread_t, kt_plink) {
                 KASSERT(NULL != thr && thr->kt_state == KT_EXITED);
                 kthread_destroy(thr);
-                dbg(DBG_PRINT, "(GRADING1A)\n");
         } list_iterate_end();
+        if (NULL != p->p_vmmap) {
+                vmmap_destroy(p->p_vmmap);
+                p->p_vmmap = NULL;
+        }
         pt_destroy_pagedir(p->p_pagedir);
-        // list_remove(&(p->p_list_link));
-        list_remove(&(p->p_child_link));
+        if (NULL != *proc_syscall_stats(p))
+                kfree(*proc_syscall_stats(p));
         slab_obj_free(proc_allocator, p);
+}
 
-        dbg(DBG_PRINT, "(GRADING1A)\n");
-        return pid;
+/*
+ * Undoes proc_create for a process that never ran, such as a fork child
+ * whose setup failed part way. None of its threads may have been made
+ * runnable.
+ */
+void
+proc_discard(proc_t *p)
+{
+        KASSERT(PROC_RUNNING == p->p_state && list_empty(&(p->p_children)));
+
+        kthread_t *thr;
+        list_iterate_begin(&(p->p_threads), thr, kthread_t, kt_plink) {
+                thr->kt_state = KT_EXITED;
+        } list_iterate_end();
+        if (NULL != *proc_fdtable(p)) {
+                fdtable_put(*proc_fdtable(p));
+                *proc_fdtable(p) = NULL;
+        }
+        if (p->p_cwd) {
+                vput(p->p_cwd);
+                p->p_cwd = NULL;
+        }
+        list_remove(&(p->p_child_link));
+        list_remove(&(p->p_list_link));
+        p->p_state = PROC_DEAD;
+        proc_destroy(p);
 }
 
 /*
@@ -508,7 +608,7 @@ do_exit(int status)
 {
         // Not supporting MTP
         curproc->p_status = status;
-        dbg(DBG_PRINT, "(GRADING1C)\n");
+        grading_dbg("(GRADING1C)\n");
         kthread_exit(NULL); // ??? status == retval?
         panic("Should never get here!\n");
 }
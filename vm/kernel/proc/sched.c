@@ -23,12 +23,16 @@
 
 #include "proc/sched.h"
 #include "proc/kthread.h"
+#include "proc/sched_stats.h"
 
 #include "util/init.h"
 #include "util/debug.h"
+#include "util/trace.h"
 
 static ktqueue_t kt_runq;
 
+int kthread_reapd_idle(void);
+
 static __attribute__((unused)) void
 sched_init(void)
 {
@@ -119,7 +123,7 @@ int
 sched_cancellable_sleep_on(ktqueue_t *q)
 {
         if (curthr->kt_cancelled) {
-                dbg(DBG_PRINT, "(GRADING1C)\n");
+                grading_dbg("(GRADING1C)\n");
                 return -EINTR;
         }
 
@@ -128,10 +132,10 @@ sched_cancellable_sleep_on(ktqueue_t *q)
         sched_switch();
 
         if (curthr->kt_cancelled) {
-                dbg(DBG_PRINT, "(GRADING1C)\n");
+                grading_dbg("(GRADING1C)\n");
                 return -EINTR;
         }
-        dbg(DBG_PRINT, "(GRADING1A)\n");
+        grading_dbg("(GRADING1A)\n");
         return 0;
 }
 
@@ -152,10 +156,10 @@ sched_cancel(struct kthread *kthr)
         if (kthr->kt_state == KT_SLEEP_CANCELLABLE) {
                 ktqueue_remove(kthr->kt_wchan, kthr);
                 sched_make_runnable(kthr);
-                dbg(DBG_PRINT, "(GRADING1C)\n");
+                grading_dbg("(GRADING1C)\n");
         }
         kthr->kt_cancelled = 1;
-        dbg(DBG_PRINT, "(GRADING1C)\n");
+        grading_dbg("(GRADING1C)\n");
 }
 
 /*
@@ -199,19 +203,24 @@ sched_switch(void)
 {
         uint8_t oldipl = intr_getipl();
         intr_setipl(IPL_HIGH);
+        sched_stats_switch_out(curthr);
         while(sched_queue_empty(&kt_runq)) {
+                /* nothing else to do, so let the reaper catch up */
+                if (kthread_reapd_idle())
+                        continue;
                 intr_disable();
                 intr_setipl(IPL_LOW);
                 intr_wait();
                 intr_setipl(IPL_HIGH);
-                dbg(DBG_PRINT, "(GRADING1A)\n");
+                grading_dbg("(GRADING1A)\n");
         }
         kthread_t *oldthr = curthr;
         curthr = ktqueue_dequeue(&kt_runq);
         curproc = curthr->kt_proc;
+        sched_stats_switch_in(curthr);
         context_switch(&(oldthr->kt_ctx), &(curthr->kt_ctx));
         intr_setipl(oldipl);
-        dbg(DBG_PRINT, "(GRADING1A)\n");
+        grading_dbg("(GRADING1A)\n");
 }
 
 /*
@@ -232,12 +241,14 @@ sched_make_runnable(kthread_t *thr)
 {
         KASSERT(NULL != thr);
         KASSERT(&kt_runq != thr->kt_wchan); /* the thr argument must not be a thread that's already in the runq */
-        dbg(DBG_PRINT, "(GRADING1A 5.a)\n");
+        grading_dbg("(GRADING1A 5.a)\n");
         uint8_t oldipl = intr_getipl();
         intr_setipl(IPL_HIGH);
+        trace(sched, "thread 0x%p (pid %d)\n", thr, thr->kt_proc->p_pid);
         thr->kt_state = KT_RUN;
+        sched_stats_runnable(thr);
         ktqueue_enqueue(&kt_runq, thr);
         intr_setipl(oldipl);
-        dbg(DBG_PRINT, "(GRADING1A)\n");
+        grading_dbg("(GRADING1A)\n");
 }
 
@@ -26,6 +26,7 @@
 
 #include "util/init.h"
 #include "util/debug.h"
+#include "util/trace.h"
 
 void ktqueue_enqueue(ktqueue_t *q, kthread_t *thr);
 kthread_t * ktqueue_dequeue(ktqueue_t *q);
@@ -46,7 +47,7 @@ sched_sleep_on(ktqueue_t *q)
 	ktqueue_enqueue(q, curthr);
 	sched_switch();
         intr_setipl(oldipl); // ???
-        dbg(DBG_PRINT, "(GRADING1A)\n");
+        grading_dbg("(GRADING1A)\n");
 }
 
 kthread_t *
@@ -56,13 +57,13 @@ sched_wakeup_on(ktqueue_t *q)
 		kthread_t * thr = ktqueue_dequeue(q);
 		/* thr must be in either one of these two states */	
 		KASSERT((thr->kt_state == KT_SLEEP) || (thr->kt_state == KT_SLEEP_CANCELLABLE));	
-		dbg(DBG_PRINT, "(GRADING1A 4.a)\n");
+		grading_dbg("(GRADING1A 4.a)\n");
 
 		sched_make_runnable(thr);
-                dbg(DBG_PRINT, "(GRADING1A)\n");
+                grading_dbg("(GRADING1A)\n");
 		return thr;
 	}
-        dbg(DBG_PRINT, "(GRADING1C)\n");
+        grading_dbg("(GRADING1C)\n");
         return NULL;
 }
 
@@ -73,8 +74,8 @@ sched_broadcast_on(ktqueue_t *q)
 	while(!sched_queue_empty(q)){
 		thr = ktqueue_dequeue(q);
 		sched_make_runnable(thr);
-                dbg(DBG_PRINT, "(GRADING1C)\n");
+                grading_dbg("(GRADING1C)\n");
 	}
-        dbg(DBG_PRINT, "(GRADING1A)\n");
+        grading_dbg("(GRADING1A)\n");
 }
 
@@ -0,0 +1,279 @@
+/******************************************************************************/
+/* Important Spring 2020 CSCI 402 usage information:                          */
+/*                                                                            */
+/* This fils is part of CSCI 402 kernel programming assignments at USC.       */
+/*         53616c7465645f5fd1e93dbf35cbffa3aef28f8c01d8cf2ffc51ef62b26a       */
+/*         f9bda5a68e5ed8c972b17bab0f42e24b19daa7bd408305b1f7bd6c7208c1       */
+/*         0e36230e913039b3046dd5fd0ba706a624d33dbaa4d6aab02c82fe09f561       */
+/*         01b0fd977b0051f0b0ce0c69f7db857b1b5e007be2db6d42894bf93de848       */
+/*         806d9152bd5715e9                                                   */
+/* Please understand that you are NOT permitted to distribute or publically   */
+/*         display a copy of this file (or ANY PART of it) for any reason.    */
+/* If anyone (including your prospective employer) asks you to post the code, */
+/*         you must inform them that you do NOT have permissions to do so.    */
+/* You are also NOT permitted to remove or alter this comment block.          */
+/* If this comment block is removed or altered in a submitted file, 20 points */
+/*         will be deducted.                                                  */
+/******************************************************************************/
+
+#include "globals.h"
+#include "errno.h"
+
+#include "util/debug.h"
+#include "util/string.h"
+#include "util/list.h"
+#include "util/tsc.h"
+
+#include "proc/proc.h"
+#include "proc/kthread.h"
+#include "proc/sched.h"
+#include "proc/sched_stats.h"
+
+#include "test/kshell/kshell.h"
+
+/*
+ * System-wide totals. Only the histograms of sched_global are used.
+ */
+static sched_stats_t sched_global;
+
+/*
+ * Sleep time broken down by wait channel. Channels are identified by the
+ * address of their ktqueue_t and kept in a small open-addressed table.
+ * Queues are freed without telling us, so rather than let dead channels
+ * fill the table for good, a new channel that finds it full takes over
+ * the slot that has gone longest without a wakeup, and that slot's sleeps
+ * move to the "other wait channels" histogram. A dead queue stops being
+ * woken up, so however busy it once was it ages out.
+ */
+#define SCHED_WCHAN_SLOTS 64
+#define hash_wchan(q) ((((uint32_t)(q)) >> 2) % SCHED_WCHAN_SLOTS)
+
+typedef struct sched_wchan_stats {
+        ktqueue_t      *sw_wchan;
+        uint64_t        sw_last;        /* TSC of the last wakeup recorded */
+        sched_hist_t    sw_sleep;
+} sched_wchan_stats_t;
+
+static sched_wchan_stats_t sched_wchan_stats[SCHED_WCHAN_SLOTS];
+static sched_hist_t sched_wchan_other;
+
+static void
+sched_hist_add(sched_hist_t *h, uint64_t cycles)
+{
+        int b = tsc_log2(cycles);
+        if (b >= SCHED_HIST_BUCKETS)
+                b = SCHED_HIST_BUCKETS - 1;
+        h->sh_count[b]++;
+}
+
+/* The histogram to record one sleep on q, ending at TSC now, in */
+static sched_hist_t *
+sched_wchan_hist(ktqueue_t *q, uint64_t now)
+{
+        sched_wchan_stats_t *sw, *victim = NULL;
+        int i, b, slot = hash_wchan(q);
+
+        for (i = 0; i < SCHED_WCHAN_SLOTS; ++i) {
+                sw = &sched_wchan_stats[(slot + i) % SCHED_WCHAN_SLOTS];
+                if (sw->sw_wchan == q)
+                        goto found;
+                if (NULL == sw->sw_wchan) {
+                        sw->sw_wchan = q;
+                        goto found;
+                }
+                if (NULL == victim || sw->sw_last < victim->sw_last)
+                        victim = sw;
+        }
+
+        for (b = 0; b < SCHED_HIST_BUCKETS; ++b)
+                sched_wchan_other.sh_count[b] += victim->sw_sleep.sh_count[b];
+        memset(victim, 0, sizeof(*victim));
+        victim->sw_wchan = q;
+        sw = victim;
+found:
+        sw->sw_last = now;
+        return &sw->sw_sleep;
+}
+
+void
+sched_stats_init_thread(sched_stats_t *ss)
+{
+        memset(ss, 0, sizeof(*ss));
+        ss->ss_where = SCHED_STATS_NONE;
+}
+
+/*
+ * thr is being put on the run queue: it either just woke up or is the
+ * current thread giving up the CPU.
+ */
+void
+sched_stats_runnable(kthread_t *thr)
+{
+        sched_stats_t *ss = kthread_sched_stats(thr);
+        uint64_t now = rdtsc();
+        uint64_t delta = now - ss->ss_stamp;
+
+        if (SCHED_STATS_RUNNING == ss->ss_where) {
+                sched_hist_add(&ss->ss_run, delta);
+                sched_hist_add(&sched_global.ss_run, delta);
+        } else if (SCHED_STATS_SLEEPING == ss->ss_where) {
+                sched_hist_add(&ss->ss_sleep, delta);
+                sched_hist_add(&sched_global.ss_sleep, delta);
+                sched_hist_add(sched_wchan_hist(ss->ss_wchan, now), delta);
+                ss->ss_wchan = NULL;
+        }
+        ss->ss_where = SCHED_STATS_RUNQ;
+        ss->ss_stamp = now;
+}
+
+/*
+ * oldthr is giving up the CPU in sched_switch. If it is going to sleep,
+ * start timing the sleep; if it yielded, sched_stats_runnable has
+ * already closed its run interval.
+ */
+void
+sched_stats_switch_out(kthread_t *oldthr)
+{
+        sched_stats_t *ss = kthread_sched_stats(oldthr);
+        uint64_t now = rdtsc();
+
+        if (SCHED_STATS_RUNQ == ss->ss_where)
+                return;
+
+        if (SCHED_STATS_RUNNING == ss->ss_where) {
+                sched_hist_add(&ss->ss_run, now - ss->ss_stamp);
+                sched_hist_add(&sched_global.ss_run, now - ss->ss_stamp);
+        }
+        if (KT_SLEEP == oldthr->kt_state || KT_SLEEP_CANCELLABLE == oldthr->kt_state) {
+                ss->ss_where = SCHED_STATS_SLEEPING;
+                ss->ss_wchan = oldthr->kt_wchan;
+        } else {
+                ss->ss_where = SCHED_STATS_NONE;
+        }
+        ss->ss_stamp = now;
+}
+
+/* newthr was just taken off the run queue and is about to run. */
+void
+sched_stats_switch_in(kthread_t *newthr)
+{
+        sched_stats_t *ss = kthread_sched_stats(newthr);
+        uint64_t now = rdtsc();
+
+        if (SCHED_STATS_RUNQ == ss->ss_where) {
+                sched_hist_add(&ss->ss_runq, now - ss->ss_stamp);
+                sched_hist_add(&sched_global.ss_runq, now - ss->ss_stamp);
+        }
+        ss->ss_where = SCHED_STATS_RUNNING;
+        ss->ss_stamp = now;
+}
+
+/* ------------------------------------------------------------------ */
+/* ------------------------- KSHELL COMMAND ------------------------- */
+/* ------------------------------------------------------------------ */
+
+static void
+sched_hist_print(kshell_t *ksh, const char *name, const sched_hist_t *h)
+{
+        uint32_t total = 0;
+        int i;
+
+        for (i = 0; i < SCHED_HIST_BUCKETS; ++i)
+                total += h->sh_count[i];
+        kprintf(ksh, "  %-10s %u samples\n", name, total);
+        for (i = 0; i < SCHED_HIST_BUCKETS; ++i) {
+                if (h->sh_count[i])
+                        kprintf(ksh, "    2^%-2d cycles %10u\n", i, h->sh_count[i]);
+        }
+}
+
+static void
+sched_stats_print(kshell_t *ksh, const sched_stats_t *ss)
+{
+        sched_hist_print(ksh, "run queue", &ss->ss_runq);
+        sched_hist_print(ksh, "running", &ss->ss_run);
+        sched_hist_print(ksh, "sleeping", &ss->ss_sleep);
+}
+
+static void
+sched_stats_reset(void)
+{
+        proc_t *p;
+        kthread_t *thr;
+
+        memset(&sched_global, 0, sizeof(sched_global));
+        memset(sched_wchan_stats, 0, sizeof(sched_wchan_stats));
+        memset(&sched_wchan_other, 0, sizeof(sched_wchan_other));
+        list_iterate_begin(proc_list(), p, proc_t, p_list_link) {
+                list_iterate_begin(&p->p_threads, thr, kthread_t, kt_plink) {
+                        sched_stats_t *ss = kthread_sched_stats(thr);
+                        memset(&ss->ss_runq, 0, sizeof(ss->ss_runq));
+                        memset(&ss->ss_run, 0, sizeof(ss->ss_run));
+                        memset(&ss->ss_sleep, 0, sizeof(ss->ss_sleep));
+                } list_iterate_end();
+        } list_iterate_end();
+}
+
+/*
+ * schedstat          - system-wide histograms, plus sleep time per wait channel
+ * schedstat <pid>    - histograms for each thread of the given process
+ * schedstat reset    - clear everything
+ */
+static int
+sched_stats_cmd(kshell_t *ksh, int argc, char **argv)
+{
+        if (argc > 2) {
+                kprintf(ksh, "usage: schedstat [pid | reset]\n");
+                return 0;
+        }
+
+        if (1 == argc) {
+                int i;
+                kprintf(ksh, "all threads:\n");
+                sched_stats_print(ksh, &sched_global);
+                kprintf(ksh, "sleeping, by wait channel:\n");
+                for (i = 0; i < SCHED_WCHAN_SLOTS; ++i) {
+                        if (NULL != sched_wchan_stats[i].sw_wchan) {
+                                kprintf(ksh, " wchan 0x%p\n", sched_wchan_stats[i].sw_wchan);
+                                sched_hist_print(ksh, "sleeping", &sched_wchan_stats[i].sw_sleep);
+                        }
+                }
+                kprintf(ksh, " other wait channels\n");
+                sched_hist_print(ksh, "sleeping", &sched_wchan_other);
+                return 0;
+        }
+
+        if (0 == strcmp(argv[1], "reset")) {
+                sched_stats_reset();
+                return 0;
+        }
+
+        const char *c;
+        int pid = 0;
+        for (c = argv[1]; *c; ++c) {
+                if (*c < '0' || *c > '9') {
+                        kprintf(ksh, "schedstat: bad pid \"%s\"\n", argv[1]);
+                        return 0;
+                }
+                pid = pid * 10 + (*c - '0');
+        }
+
+        proc_t *p = proc_lookup(pid);
+        if (NULL == p) {
+                kprintf(ksh, "schedstat: no process %d\n", pid);
+                return 0;
+        }
+        kthread_t *thr;
+        list_iterate_begin(&p->p_threads, thr, kthread_t, kt_plink) {
+                kprintf(ksh, "pid %d (%s) thread 0x%p:\n", p->p_pid, p->p_comm, thr);
+                sched_stats_print(ksh, kthread_sched_stats(thr));
+        } list_iterate_end();
+        return 0;
+}
+
+void
+sched_stats_kshell_init(void)
+{
+        kshell_add_command("schedstat", sched_stats_cmd,
+                           "print scheduler latency histograms");
+}
@@ -0,0 +1,108 @@
+/******************************************************************************/
+/* Important Spring 2020 CSCI 402 usage information:                          */
+/*                                                                            */
+/* This fils is part of CSCI 402 kernel programming assignments at USC.       */
+/*         53616c7465645f5fd1e93dbf35cbffa3aef28f8c01d8cf2ffc51ef62b26a       */
+/*         f9bda5a68e5ed8c972b17bab0f42e24b19daa7bd408305b1f7bd6c7208c1       */
+/*         0e36230e913039b3046dd5fd0ba706a624d33dbaa4d6aab02c82fe09f561       */
+/*         01b0fd977b0051f0b0ce0c69f7db857b1b5e007be2db6d42894bf93de848       */
+/*         806d9152bd5715e9                                                   */
+/* Please understand that you are NOT permitted to distribute or publically   */
+/*         display a copy of this file (or ANY PART of it) for any reason.    */
+/* If anyone (including your prospective employer) asks you to post the code, */
+/*         you must inform them that you do NOT have permissions to do so.    */
+/* You are also NOT permitted to remove or alter this comment block.          */
+/* If this comment block is removed or altered in a submitted file, 20 points */
+/*         will be deducted.                                                  */
+/******************************************************************************/
+
+/*
+ * Path lookup microbenchmark: resolves a deep path over and over and
+ * reports the average cost of open_namev in TSC cycles.
+ *
+ * namevbench [depth [iterations]]
+ */
+
+#include "kernel.h"
+#include "globals.h"
+#include "errno.h"
+
+#include "util/debug.h"
+#include "util/string.h"
+#include "util/printf.h"
+#include "util/tsc.h"
+
+#include "fs/vfs.h"
+#include "fs/vnode.h"
+#include "fs/vfs_syscall.h"
+#include "fs/fcntl.h"
+
+#include "test/kshell/kshell.h"
+#include "test/bench.h"
+
+#define NAMEV_BENCH_ROOT        "/namevbench"
+#define NAMEV_BENCH_MAXDEPTH    64
+#define NAMEV_BENCH_PATHLEN     (sizeof(NAMEV_BENCH_ROOT) + 4 * NAMEV_BENCH_MAXDEPTH)
+
+/* Fills path with NAMEV_BENCH_ROOT followed by depth components */
+static void
+namev_bench_path(char *path, int depth)
+{
+        int i;
+        strcpy(path, NAMEV_BENCH_ROOT);
+        for (i = 0; i < depth; ++i)
+                snprintf(path + strlen(path), 5, "/d%02d", i);
+}
+
+int
+namev_bench(kshell_t *ksh, int argc, char **argv)
+{
+        int depth = bench_arg(argc > 1 ? argv[1] : NULL, 16);
+        int iters = bench_arg(argc > 2 ? argv[2] : NULL, 1000);
+        char path[NAMEV_BENCH_PATHLEN];
+        uint64_t start, cycles;
+        uint32_t per;
+        vnode_t *vn;
+        int i, err;
+
+        if (depth > NAMEV_BENCH_MAXDEPTH)
+                depth = NAMEV_BENCH_MAXDEPTH;
+
+        /* build the tree */
+        for (i = 0; i <= depth; ++i) {
+                namev_bench_path(path, i);
+                if (0 > (err = do_mkdir(path)) && -EEXIST != err) {
+                        kprintf(ksh, "namevbench: mkdir %s: %d\n", path, err);
+                        goto cleanup;
+                }
+        }
+
+        /* walk it once first so only cached lookups are measured */
+        namev_bench_path(path, depth);
+        if (0 > (err = open_namev(path, 0, &vn, NULL))) {
+                kprintf(ksh, "namevbench: lookup %s: %d\n", path, err);
+                goto cleanup;
+        }
+        vput(vn);
+
+        start = rdtsc();
+        for (i = 0; i < iters; ++i) {
+                if (0 > (err = open_namev(path, 0, &vn, NULL))) {
+                        kprintf(ksh, "namevbench: lookup %s: %d\n", path, err);
+                        goto cleanup;
+                }
+                vput(vn);
+        }
+        cycles = rdtsc() - start;
+
+        per = bench_per(cycles, iters);
+        kprintf(ksh, "%d lookups of a %d component path: %u cycles each, %u per component\n",
+                iters, depth + 1, per, per / (depth + 1));
+
+cleanup:
+        for (i = depth; i >= 0; --i) {
+                namev_bench_path(path, i);
+                do_rmdir(path);
+        }
+        return 0;
+}
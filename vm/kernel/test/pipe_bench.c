@@ -0,0 +1,129 @@
+/******************************************************************************/
+/* Important Spring 2020 CSCI 402 usage information:                          */
+/*                                                                            */
+/* This fils is part of CSCI 402 kernel programming assignments at USC.       */
+/*         53616c7465645f5fd1e93dbf35cbffa3aef28f8c01d8cf2ffc51ef62b26a       */
+/*         f9bda5a68e5ed8c972b17bab0f42e24b19daa7bd408305b1f7bd6c7208c1       */
+/*         0e36230e913039b3046dd5fd0ba706a624d33dbaa4d6aab02c82fe09f561       */
+/*         01b0fd977b0051f0b0ce0c69f7db857b1b5e007be2db6d42894bf93de848       */
+/*         806d9152bd5715e9                                                   */
+/* Please understand that you are NOT permitted to distribute or publically   */
+/*         display a copy of this file (or ANY PART of it) for any reason.    */
+/* If anyone (including your prospective employer) asks you to post the code, */
+/*         you must inform them that you do NOT have permissions to do so.    */
+/* You are also NOT permitted to remove or alter this comment block.          */
+/* If this comment block is removed or altered in a submitted file, 20 points */
+/*         will be deducted.                                                  */
+/******************************************************************************/
+
+/*
+ * Pipe throughput benchmark: a child process streams data into a pipe
+ * while the shell thread drains it, and the elapsed TSC cycles are
+ * reported.
+ *
+ * pipebench [kilobytes [chunk]]
+ */
+
+#include "kernel.h"
+#include "globals.h"
+#include "errno.h"
+
+#include "util/debug.h"
+#include "util/string.h"
+#include "util/tsc.h"
+
+#include "proc/proc.h"
+#include "proc/kthread.h"
+#include "proc/sched.h"
+
+#include "mm/kmalloc.h"
+
+#include "fs/vnode.h"
+#include "fs/file.h"
+#include "fs/vfs_syscall.h"
+#include "fs/pipefs.h"
+#include "fs/fdtable.h"
+
+#include "test/kshell/kshell.h"
+#include "test/bench.h"
+
+#define PIPE_BENCH_MAXCHUNK     PAGE_SIZE
+
+/* Writes arg1 bytes of "y\n" into the write end passed in arg2, in chunks
+ * of PIPE_BENCH_MAXCHUNK, then drops its reference to it */
+static void *
+pipe_bench_writer(int arg1, void *arg2)
+{
+        vnode_t *wvn = (vnode_t *)arg2;
+        char *buf;
+        int left = arg1;
+        int i, n;
+
+        if (NULL == (buf = kmalloc(PIPE_BENCH_MAXCHUNK))) {
+                vput(wvn);
+                return NULL;
+        }
+        for (i = 0; i < PIPE_BENCH_MAXCHUNK; i += 2) {
+                buf[i] = 'y';
+                buf[i + 1] = '\n';
+        }
+        while (left > 0) {
+                n = left < PIPE_BENCH_MAXCHUNK ? left : PIPE_BENCH_MAXCHUNK;
+                if (0 > (n = wvn->vn_ops->write(wvn, 0, buf, n)))
+                        break;
+                left -= n;
+        }
+        kfree(buf);
+        vput(wvn);
+        return NULL;
+}
+
+int
+pipe_bench(kshell_t *ksh, int argc, char **argv)
+{
+        int total = bench_arg(argc > 1 ? argv[1] : NULL, 4096) * 1024;
+        int chunk = bench_arg(argc > 2 ? argv[2] : NULL, PIPE_BENCH_MAXCHUNK);
+        vnode_t *rvn, *wvn;
+        proc_t *p;
+        kthread_t *thr;
+        uint64_t start, cycles;
+        char *buf;
+        int fds[2];
+        int got, n, status;
+
+        if (chunk > PIPE_BENCH_MAXCHUNK)
+                chunk = PIPE_BENCH_MAXCHUNK;
+        if (NULL == (buf = kmalloc(chunk)))
+                return -ENOMEM;
+        if (0 > (n = pipefs_pipe(fds))) {
+                kprintf(ksh, "pipebench: pipe: %d\n", n);
+                kfree(buf);
+                return n;
+        }
+        rvn = fd_lookup(curproc, fds[0])->f_vnode;
+        wvn = fd_lookup(curproc, fds[1])->f_vnode;
+
+        /* the writer gets its own reference to the write end */
+        vref(wvn);
+        p = proc_create("pipebench");
+        KASSERT(NULL != p);
+        thr = kthread_create(p, pipe_bench_writer, total, wvn);
+        KASSERT(NULL != thr);
+
+        start = rdtsc();
+        sched_make_runnable(thr);
+        for (got = 0; got < total; got += n) {
+                if (0 >= (n = rvn->vn_ops->read(rvn, 0, buf, chunk)))
+                        break;
+        }
+        cycles = rdtsc() - start;
+
+        do_waitpid(p->p_pid, 0, &status);
+        do_close(fds[0]);
+        do_close(fds[1]);
+        kfree(buf);
+
+        kprintf(ksh, "%d KB through a pipe in %d byte reads: %u Mcycles\n",
+                got >> 10, chunk, (uint32_t)(cycles >> 20));
+        return 0;
+}
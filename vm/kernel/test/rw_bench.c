@@ -0,0 +1,74 @@
+/******************************************************************************/
+/* Important Spring 2020 CSCI 402 usage information:                          */
+/*                                                                            */
+/* This fils is part of CSCI 402 kernel programming assignments at USC.       */
+/*         53616c7465645f5fd1e93dbf35cbffa3aef28f8c01d8cf2ffc51ef62b26a       */
+/*         f9bda5a68e5ed8c972b17bab0f42e24b19daa7bd408305b1f7bd6c7208c1       */
+/*         0e36230e913039b3046dd5fd0ba706a624d33dbaa4d6aab02c82fe09f561       */
+/*         01b0fd977b0051f0b0ce0c69f7db857b1b5e007be2db6d42894bf93de848       */
+/*         806d9152bd5715e9                                                   */
+/* Please understand that you are NOT permitted to distribute or publically   */
+/*         display a copy of this file (or ANY PART of it) for any reason.    */
+/* If anyone (including your prospective employer) asks you to post the code, */
+/*         you must inform them that you do NOT have permissions to do so.    */
+/* You are also NOT permitted to remove or alter this comment block.          */
+/* If this comment block is removed or altered in a submitted file, 20 points */
+/*         will be deducted.                                                  */
+/******************************************************************************/
+
+/*
+ * Small-I/O syscall microbenchmark: one-byte reads from /dev/zero and
+ * writes to /dev/null, so the cost measured is almost all the VFS path
+ * (fd lookup, checks, f_pos update) rather than data movement.
+ *
+ * rwbench [iterations]
+ */
+
+#include "kernel.h"
+#include "globals.h"
+#include "errno.h"
+
+#include "util/debug.h"
+#include "util/tsc.h"
+
+#include "fs/vfs_syscall.h"
+#include "fs/fcntl.h"
+
+#include "test/kshell/kshell.h"
+#include "test/bench.h"
+
+int
+rw_bench(kshell_t *ksh, int argc, char **argv)
+{
+        int iters = bench_arg(argc > 1 ? argv[1] : NULL, 10000);
+        uint64_t start, rcycles, wcycles;
+        int zfd, nfd, i;
+        char c;
+
+        if ((zfd = do_open("/dev/zero", O_RDONLY)) < 0) {
+                kprintf(ksh, "rwbench: open /dev/zero: %d\n", zfd);
+                return zfd;
+        }
+        if ((nfd = do_open("/dev/null", O_WRONLY)) < 0) {
+                kprintf(ksh, "rwbench: open /dev/null: %d\n", nfd);
+                do_close(zfd);
+                return nfd;
+        }
+
+        start = rdtsc();
+        for (i = 0; i < iters; ++i)
+                do_read(zfd, &c, 1);
+        rcycles = rdtsc() - start;
+
+        start = rdtsc();
+        for (i = 0; i < iters; ++i)
+                do_write(nfd, &c, 1);
+        wcycles = rdtsc() - start;
+
+        do_close(nfd);
+        do_close(zfd);
+
+        kprintf(ksh, "%d one-byte calls: read %u cycles each, write %u cycles each\n",
+                iters, bench_per(rcycles, iters), bench_per(wcycles, iters));
+        return 0;
+}
@@ -0,0 +1,82 @@
+/******************************************************************************/
+/* Important Spring 2020 CSCI 402 usage information:                          */
+/*                                                                            */
+/* This fils is part of CSCI 402 kernel programming assignments at USC.       */
+/*         53616c7465645f5fd1e93dbf35cbffa3aef28f8c01d8cf2ffc51ef62b26a       */
+/*         f9bda5a68e5ed8c972b17bab0f42e24b19daa7bd408305b1f7bd6c7208c1       */
+/*         0e36230e913039b3046dd5fd0ba706a624d33dbaa4d6aab02c82fe09f561       */
+/*         01b0fd977b0051f0b0ce0c69f7db857b1b5e007be2db6d42894bf93de848       */
+/*         806d9152bd5715e9                                                   */
+/* Please understand that you are NOT permitted to distribute or publically   */
+/*         display a copy of this file (or ANY PART of it) for any reason.    */
+/* If anyone (including your prospective employer) asks you to post the code, */
+/*         you must inform them that you do NOT have permissions to do so.    */
+/* You are also NOT permitted to remove or alter this comment block.          */
+/* If this comment block is removed or altered in a submitted file, 20 points */
+/*         will be deducted.                                                  */
+/******************************************************************************/
+
+/*
+ * Unmounts a tmpfs that still has files in it, as happens to /tmp at
+ * every shutdown: mounts a scratch tmpfs, leaves a directory with a file
+ * in it, and unmounts it again. Without a fix this panics in tmpfs.
+ *
+ * tmpfstest
+ */
+
+#include "kernel.h"
+#include "globals.h"
+#include "errno.h"
+
+#include "util/debug.h"
+
+#include "fs/vfs_syscall.h"
+#include "fs/fcntl.h"
+
+#include "test/kshell/kshell.h"
+
+#ifdef __MOUNTING__
+
+#define TMPFS_TEST_MNT  "/tmpfstest"
+
+int
+tmpfs_test(kshell_t *ksh, int argc, char **argv)
+{
+        int err, uerr, fd;
+
+        if (0 > (err = do_mkdir(TMPFS_TEST_MNT)) && -EEXIST != err) {
+                kprintf(ksh, "tmpfstest: mkdir %s: %d\n", TMPFS_TEST_MNT, err);
+                return err;
+        }
+        if ((err = do_mount("", TMPFS_TEST_MNT, "tmpfs")) < 0) {
+                kprintf(ksh, "tmpfstest: mount: %d\n", err);
+                goto out;
+        }
+
+        if ((err = do_mkdir(TMPFS_TEST_MNT "/dir")) < 0) {
+                kprintf(ksh, "tmpfstest: mkdir: %d\n", err);
+                goto umount;
+        }
+        if ((fd = do_open(TMPFS_TEST_MNT "/dir/file", O_CREAT | O_WRONLY)) < 0) {
+                err = fd;
+                kprintf(ksh, "tmpfstest: open: %d\n", err);
+                goto umount;
+        }
+        err = do_write(fd, "tmpfs\n", 6);
+        do_close(fd);
+        if (err < 0)
+                kprintf(ksh, "tmpfstest: write: %d\n", err);
+
+umount:
+        if ((uerr = do_umount(TMPFS_TEST_MNT)) < 0)
+                kprintf(ksh, "tmpfstest: umount: %d\n", uerr);
+        else if (err >= 0)
+                kprintf(ksh, "tmpfstest: unmounted a non-empty tmpfs\n");
+        if (err >= 0)
+                err = uerr;
+out:
+        do_rmdir(TMPFS_TEST_MNT);
+        return err;
+}
+
+#endif /* __MOUNTING__ */
@@ -0,0 +1,84 @@
+/******************************************************************************/
+/* Important Spring 2020 CSCI 402 usage information:                          */
+/*                                                                            */
+/* This fils is part of CSCI 402 kernel programming assignments at USC.       */
+/*         53616c7465645f5fd1e93dbf35cbffa3aef28f8c01d8cf2ffc51ef62b26a       */
+/*         f9bda5a68e5ed8c972b17bab0f42e24b19daa7bd408305b1f7bd6c7208c1       */
+/*         0e36230e913039b3046dd5fd0ba706a624d33dbaa4d6aab02c82fe09f561       */
+/*         01b0fd977b0051f0b0ce0c69f7db857b1b5e007be2db6d42894bf93de848       */
+/*         806d9152bd5715e9                                                   */
+/* Please understand that you are NOT permitted to distribute or publically   */
+/*         display a copy of this file (or ANY PART of it) for any reason.    */
+/* If anyone (including your prospective employer) asks you to post the code, */
+/*         you must inform them that you do NOT have permissions to do so.    */
+/* You are also NOT permitted to remove or alter this comment block.          */
+/* If this comment block is removed or altered in a submitted file, 20 points */
+/*         will be deducted.                                                  */
+/******************************************************************************/
+
+#include "globals.h"
+
+#include "util/debug.h"
+#include "util/string.h"
+#include "util/trace.h"
+
+#include "test/kshell/kshell.h"
+
+uint8_t trace_enabled[TRACE_NKEYS];
+
+#define TRACE_KEY_NAME(name) #name,
+static const char *trace_names[TRACE_NKEYS] = {
+        TRACE_KEYS(TRACE_KEY_NAME)
+};
+#undef TRACE_KEY_NAME
+
+/*
+ * trace                  - list the trace keys and whether they are on
+ * trace <key> on|off     - switch a key (or "all" of them) on or off
+ */
+static int
+trace_cmd(kshell_t *ksh, int argc, char **argv)
+{
+        int i, on;
+
+        if (1 == argc) {
+                for (i = 0; i < TRACE_NKEYS; ++i)
+                        kprintf(ksh, "%-10s %s\n", trace_names[i],
+                                trace_enabled[i] ? "on" : "off");
+                return 0;
+        }
+
+        if (3 != argc) {
+                kprintf(ksh, "usage: trace [<key> on|off]\n");
+                return 0;
+        }
+
+        if (0 == strcmp(argv[2], "on")) {
+                on = 1;
+        } else if (0 == strcmp(argv[2], "off")) {
+                on = 0;
+        } else {
+                kprintf(ksh, "usage: trace [<key> on|off]\n");
+                return 0;
+        }
+
+        if (0 == strcmp(argv[1], "all")) {
+                memset(trace_enabled, on, sizeof(trace_enabled));
+                return 0;
+        }
+
+        for (i = 0; i < TRACE_NKEYS; ++i) {
+                if (0 == strcmp(argv[1], trace_names[i])) {
+                        trace_enabled[i] = on;
+                        return 0;
+                }
+        }
+        kprintf(ksh, "trace: no such key \"%s\"\n", argv[1]);
+        return 0;
+}
+
+void
+trace_kshell_init(void)
+{
+        kshell_add_command("trace", trace_cmd, "turn trace points on or off");
+}
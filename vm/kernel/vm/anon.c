@@ -21,6 +21,7 @@
 
 #include "util/string.h"
 #include "util/debug.h"
+#include "util/trace.h"
 
 #include "mm/mmobj.h"
 #include "mm/pframe.h"
@@ -59,8 +60,8 @@ anon_init()
 {
         anon_allocator = slab_allocator_create("anon", sizeof(mmobj_t));
         KASSERT(anon_allocator); /* after initialization, anon_allocator must not be NULL */
-        dbg(DBG_PRINT, "(GRADING3A 4.a)\n");
-        dbg(DBG_PRINT, "(GRADING3A)\n");
+        grading_dbg("(GRADING3A 4.a)\n");
+        grading_dbg("(GRADING3A)\n");
 }
 
 /*
@@ -77,9 +78,9 @@ anon_create()
                 mmobj_init(mmo, &anon_mmobj_ops);
                 mmo->mmo_refcount = 1;
                 // mmo->mmo_nrespages = 0;
-                dbg(DBG_PRINT, "(GRADING3A)\n");
+                grading_dbg("(GRADING3A)\n");
         }
-        dbg(DBG_PRINT, "(GRADING3A)\n");
+        grading_dbg("(GRADING3A)\n");
         return mmo;
 }
 
@@ -93,9 +94,9 @@ anon_ref(mmobj_t *o)
 {
         KASSERT(o && (0 < o->mmo_refcount) && (&anon_mmobj_ops == o->mmo_ops));
                                   /* the o function argument must be non-NULL, has a positive refcount, and is an anonymous object */
-        dbg(DBG_PRINT, "(GRADING3A 4.b)\n");
+        grading_dbg("(GRADING3A 4.b)\n");
         o->mmo_refcount++;
-        dbg(DBG_PRINT, "(GRADING3A)\n");
+        grading_dbg("(GRADING3A)\n");
 }
 
 /*
@@ -111,7 +112,7 @@ anon_put(mmobj_t *o)
 {
         KASSERT(o && (0 < o->mmo_refcount) && (&anon_mmobj_ops == o->mmo_ops));
                                   /* the o function argument must be non-NULL, has a positive refcount, and is an anonymous object */
-        dbg(DBG_PRINT, "(GRADING3A 4.c)\n");
+        grading_dbg("(GRADING3A 4.c)\n");
 
         if (o->mmo_nrespages == (o->mmo_refcount - 1)) {
                 pframe_t *pf;
@@ -121,19 +122,19 @@ anon_put(mmobj_t *o)
                         }*/
                         pframe_unpin(pf);
                         pframe_free(pf);
-                        dbg(DBG_PRINT, "(GRADING3A)\n");
+                        grading_dbg("(GRADING3A)\n");
                 } list_iterate_end();
                 
                 KASSERT(0 == o->mmo_nrespages);
                 KASSERT(1 == o->mmo_refcount);
-                dbg(DBG_PRINT, "(GRADING3A)\n");
+                grading_dbg("(GRADING3A)\n");
         }
         if (0 < --o->mmo_refcount) {
-                dbg(DBG_PRINT, "(GRADING3A)\n");
+                grading_dbg("(GRADING3A)\n");
                 return;
         }
         slab_obj_free(anon_allocator, o);
-        dbg(DBG_PRINT, "(GRADING3A)\n");
+        grading_dbg("(GRADING3A)\n");
 }
 
 /* Get the corresponding page from the mmobj. No special handling is
@@ -141,7 +142,7 @@ anon_put(mmobj_t *o)
 static int
 anon_lookuppage(mmobj_t *o, uint32_t pagenum, int forwrite, pframe_t **pf)
 {
-        dbg(DBG_PRINT, "(GRADING3A)\n");
+        grading_dbg("(GRADING3A)\n");
         return pframe_get(o, pagenum, pf);
 }
 
@@ -152,11 +153,11 @@ anon_fillpage(mmobj_t *o, pframe_t *pf)
 {
         KASSERT(pframe_is_busy(pf)); /* can only "fill" a page frame when the page frame is in the "busy" state */
         KASSERT(!pframe_is_pinned(pf)); /* must not fill a page frame that's already pinned */
-        dbg(DBG_PRINT, "(GRADING3A 4.d)\n");
+        grading_dbg("(GRADING3A 4.d)\n");
 
         memset(pf->pf_addr, 0, PAGE_SIZE);
         pframe_pin(pf);
-        dbg(DBG_PRINT, "(GRADING3A)\n");
+        grading_dbg("(GRADING3A)\n");
         return 0;
 }
 
@@ -19,6 +19,7 @@
 #include "globals.h"
 #include "errno.h"
 #include "util/debug.h"
+#include "util/trace.h"
 
 #include "mm/mm.h"
 #include "mm/page.h"
@@ -26,6 +27,7 @@
 
 #include "vm/mmap.h"
 #include "vm/vmmap.h"
+#include "vm/vmmap_lock.h"
 
 #include "proc/proc.h"
 
@@ -75,12 +77,12 @@ do_brk(void *addr, void **ret)
 {
         if (NULL == addr) {
                 *ret = curproc->p_brk;
-                dbg(DBG_PRINT, "(GRADING3A)\n");
+                grading_dbg("(GRADING3A)\n");
                 return 0;
         }
         if (addr < curproc->p_start_brk || addr > (void *) USER_MEM_HIGH) {
                 *ret = NULL;
-                dbg(DBG_PRINT, "(GRADING3D 1)\n");
+                grading_dbg("(GRADING3D 1)\n");
                 return -ENOMEM;
         }
         uint32_t addr_pn = ADDR_TO_PN(PAGE_ALIGN_UP(addr));
@@ -89,11 +91,13 @@ do_brk(void *addr, void **ret)
         if (addr_pn != brk_pn) {
                 if (addr < curproc->p_brk) {
                         vmmap_remove(curproc->p_vmmap, addr_pn, brk_pn - addr_pn);
-                        dbg(DBG_PRINT, "(GRADING3D 1)\n");
+                        grading_dbg("(GRADING3D 1)\n");
                 } else {
+                        vmmap_wrlock(curproc->p_vmmap);
                         if (!vmmap_is_range_empty(curproc->p_vmmap, brk_pn, addr_pn - brk_pn)) {
+                                vmmap_wrunlock(curproc->p_vmmap);
                                 *ret = NULL;
-                                dbg(DBG_PRINT, "(GRADING3D 2)\n");
+                                grading_dbg("(GRADING3D 2)\n");
                                 return -ENOMEM;
                         }
                         vmarea_t *vma = vmmap_lookup(curproc->p_vmmap, ADDR_TO_PN(curproc->p_start_brk));
@@ -102,12 +106,13 @@ do_brk(void *addr, void **ret)
                                 vmmap_map(curproc->p_vmmap, NULL, s_brk_pn, addr_pn - s_brk_pn, proc, MAP_PRIVATE, 0, VMMAP_DIR_LOHI, &vma);
                         }*/
                         vma->vma_end = addr_pn;
-                        dbg(DBG_PRINT, "(GRADING3A)\n");
+                        vmmap_wrunlock(curproc->p_vmmap);
+                        grading_dbg("(GRADING3A)\n");
                 }
-                dbg(DBG_PRINT, "(GRADING3A)\n");
+                grading_dbg("(GRADING3A)\n");
         }
         curproc->p_brk = addr;
         *ret = addr;
-        dbg(DBG_PRINT, "(GRADING3A)\n");
+        grading_dbg("(GRADING3A)\n");
         return 0;
 }
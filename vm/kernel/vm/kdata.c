@@ -0,0 +1,220 @@
+/******************************************************************************/
+/* Important Spring 2020 CSCI 402 usage information:                          */
+/*                                                                            */
+/* This fils is part of CSCI 402 kernel programming assignments at USC.       */
+/*         53616c7465645f5fd1e93dbf35cbffa3aef28f8c01d8cf2ffc51ef62b26a       */
+/*         f9bda5a68e5ed8c972b17bab0f42e24b19daa7bd408305b1f7bd6c7208c1       */
+/*         0e36230e913039b3046dd5fd0ba706a624d33dbaa4d6aab02c82fe09f561       */
+/*         01b0fd977b0051f0b0ce0c69f7db857b1b5e007be2db6d42894bf93de848       */
+/*         806d9152bd5715e9                                                   */
+/* Please understand that you are NOT permitted to distribute or publically   */
+/*         display a copy of this file (or ANY PART of it) for any reason.    */
+/* If anyone (including your prospective employer) asks you to post the code, */
+/*         you must inform them that you do NOT have permissions to do so.    */
+/* You are also NOT permitted to remove or alter this comment block.          */
+/* If this comment block is removed or altered in a submitted file, 20 points */
+/*         will be deducted.                                                  */
+/******************************************************************************/
+
+#include "kernel.h"
+#include "globals.h"
+#include "types.h"
+#include "errno.h"
+
+#include "util/init.h"
+#include "util/string.h"
+#include "util/debug.h"
+#include "util/list.h"
+#include "util/tsc.h"
+
+#include "proc/proc.h"
+
+#include "mm/mm.h"
+#include "mm/mman.h"
+#include "mm/page.h"
+#include "mm/mmobj.h"
+#include "mm/pframe.h"
+#include "mm/pagetable.h"
+#include "mm/slab.h"
+#include "mm/tlb.h"
+
+#include "vm/vmmap.h"
+#include "vm/vmmap_lock.h"
+#include "vm/kdata.h"
+
+#include "api/kdata.h"
+
+/*
+ * The kernel data page. Each process gets its own single-page mmobj,
+ * filled on first fault with the process's pid and the static uname data
+ * and pinned from then on. It is mapped read-only and shared, so a fork
+ * would otherwise hand the child its parent's page; do_fork calls
+ * kdata_map on the child to give it one of its own.
+ */
+typedef struct kdata_obj {
+        mmobj_t         ko_obj;
+        pid_t           ko_pid;
+} kdata_obj_t;
+
+static void kdata_ref(mmobj_t *o);
+static void kdata_put(mmobj_t *o);
+static int  kdata_lookuppage(mmobj_t *o, uint32_t pagenum, int forwrite, pframe_t **pf);
+static int  kdata_fillpage(mmobj_t *o, pframe_t *pf);
+static int  kdata_dirtypage(mmobj_t *o, pframe_t *pf);
+static int  kdata_cleanpage(mmobj_t *o, pframe_t *pf);
+
+static mmobj_ops_t kdata_mmobj_ops = {
+        .ref = kdata_ref,
+        .put = kdata_put,
+        .lookuppage = kdata_lookuppage,
+        .fillpage  = kdata_fillpage,
+        .dirtypage = kdata_dirtypage,
+        .cleanpage = kdata_cleanpage
+};
+
+static slab_allocator_t *kdata_allocator = NULL;
+static uint64_t kdata_tsc_boot;
+
+static __attribute__((unused)) void
+kdata_init(void)
+{
+        KASSERT(KDATA_ADDR == USER_MEM_LOW);
+        KASSERT(sizeof(kdata_t) <= PAGE_SIZE);
+
+        kdata_allocator = slab_allocator_create("kdata", sizeof(kdata_obj_t));
+        KASSERT(NULL != kdata_allocator);
+        kdata_tsc_boot = rdtsc();
+}
+init_func(kdata_init);
+
+static mmobj_t *
+kdata_create(pid_t pid)
+{
+        kdata_obj_t *ko = (kdata_obj_t *)slab_obj_alloc(kdata_allocator);
+        if (NULL == ko)
+                return NULL;
+        mmobj_init(&ko->ko_obj, &kdata_mmobj_ops);
+        ko->ko_obj.mmo_refcount = 1;
+        ko->ko_pid = pid;
+        return &ko->ko_obj;
+}
+
+static void
+kdata_ref(mmobj_t *o)
+{
+        KASSERT(o && (0 < o->mmo_refcount) && (&kdata_mmobj_ops == o->mmo_ops));
+        o->mmo_refcount++;
+}
+
+/* A resident page holds a reference on its object (see pframe_alloc), so
+ * once that is the only other one left nobody is using the page */
+static void
+kdata_put(mmobj_t *o)
+{
+        KASSERT(o && (0 < o->mmo_refcount) && (&kdata_mmobj_ops == o->mmo_ops));
+
+        if (o->mmo_nrespages == (o->mmo_refcount - 1)) {
+                pframe_t *pf;
+                list_iterate_begin(&o->mmo_respages, pf, pframe_t, pf_olink) {
+                        pframe_unpin(pf);
+                        pframe_free(pf);
+                } list_iterate_end();
+                KASSERT(0 == o->mmo_nrespages);
+        }
+        if (0 < --o->mmo_refcount)
+                return;
+        slab_obj_free(kdata_allocator, list_item(o, kdata_obj_t, ko_obj));
+}
+
+static int
+kdata_lookuppage(mmobj_t *o, uint32_t pagenum, int forwrite, pframe_t **pf)
+{
+        if (forwrite || 0 != pagenum)
+                return -EFAULT;
+        return pframe_get(o, pagenum, pf);
+}
+
+static int
+kdata_fillpage(mmobj_t *o, pframe_t *pf)
+{
+        kdata_obj_t *ko = list_item(o, kdata_obj_t, ko_obj);
+        kdata_t *kd = (kdata_t *)pf->pf_addr;
+
+        KASSERT(pframe_is_busy(pf));
+        KASSERT(!pframe_is_pinned(pf));
+
+        memset(pf->pf_addr, 0, PAGE_SIZE);
+        kd->kd_magic = KDATA_MAGIC;
+        kd->kd_pid = ko->ko_pid;
+        kd->kd_tsc_boot = kdata_tsc_boot;
+        strncpy(kd->kd_uname.sysname, KDATA_SYSNAME, sizeof(kd->kd_uname.sysname) - 1);
+        strncpy(kd->kd_uname.release, KDATA_RELEASE, sizeof(kd->kd_uname.release) - 1);
+        strncpy(kd->kd_uname.version, KDATA_VERSION, sizeof(kd->kd_uname.version) - 1);
+
+        pframe_pin(pf);
+        return 0;
+}
+
+/* Nobody can write the page: it is mapped read-only and never lent out
+ * for writing */
+static int
+kdata_dirtypage(mmobj_t *o, pframe_t *pf)
+{
+        panic("kdata: page %p of %p dirtied\n", pf, o);
+        return -1;
+}
+
+static int
+kdata_cleanpage(mmobj_t *o, pframe_t *pf)
+{
+        return 0;
+}
+
+int
+kdata_map(proc_t *p)
+{
+        vmmap_t *map = p->p_vmmap;
+        uint32_t pn = ADDR_TO_PN(KDATA_ADDR);
+        mmobj_t *obj, *old = NULL;
+        vmarea_t *vma;
+
+        if (NULL == (obj = kdata_create(p->p_pid)))
+                return -ENOMEM;
+
+        vmmap_wrlock(map);
+        if (NULL != (vma = vmmap_lookup(map, pn))) {
+                if (&kdata_mmobj_ops != vma->vma_obj->mmo_ops) {
+                        vmmap_wrunlock(map);
+                        obj->mmo_ops->put(obj);
+                        dbg(DBG_VM, "pid %d: kernel data page address taken\n", p->p_pid);
+                        return -EEXIST;
+                }
+                old = vma->vma_obj;
+                list_remove(&vma->vma_olink);
+        } else {
+                if (NULL == (vma = vmarea_alloc())) {
+                        vmmap_wrunlock(map);
+                        obj->mmo_ops->put(obj);
+                        return -ENOMEM;
+                }
+                vma->vma_start = pn;
+                vma->vma_end = pn + 1;
+                vma->vma_off = 0;
+                vma->vma_prot = PROT_READ;
+                vma->vma_flags = MAP_SHARED;
+                list_link_init(&vma->vma_plink);
+                list_link_init(&vma->vma_olink);
+                vmmap_insert(map, vma);
+        }
+        vma->vma_obj = obj;
+        list_insert_tail(&obj->mmo_un.mmo_vmas, &vma->vma_olink);
+        vmmap_wrunlock(map);
+
+        if (NULL != old) {
+                pt_unmap(p->p_pagedir, KDATA_ADDR);
+                if (curproc == p)
+                        tlb_flush(KDATA_ADDR);
+                old->mmo_ops->put(old);
+        }
+        return 0;
+}
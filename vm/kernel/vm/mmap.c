@@ -29,10 +29,12 @@
 
 #include "util/string.h"
 #include "util/debug.h"
+#include "util/trace.h"
 
 #include "fs/vnode.h"
 #include "fs/vfs.h"
 #include "fs/file.h"
+#include "fs/fdtable.h"
 
 #include "vm/vmmap.h"
 #include "vm/mmap.h"
@@ -57,48 +59,49 @@ do_mmap(void *addr, size_t len, int prot, int flags,
         vmarea_t *vma = NULL;
         
         if (!PAGE_ALIGNED(addr)){
-                dbg(DBG_PRINT, "(GRADING3D 1)\n");
+                grading_dbg("(GRADING3D 1)\n");
                 return -EINVAL;
         }
         /*if (addr != NULL && (uint32_t) addr < USER_MEM_LOW){
                 return -EINVAL;
         }*/
         if (len == 0){
-                dbg(DBG_PRINT, "(GRADING3D 1)\n");
+                grading_dbg("(GRADING3D 1)\n");
                 return -EINVAL;
         }
         if (len > USER_MEM_HIGH){
-                dbg(DBG_PRINT, "(GRADING3D 1)\n");
+                grading_dbg("(GRADING3D 1)\n");
                 return -EINVAL;
         }
         /*if (addr != NULL && len > USER_MEM_HIGH - (uint32_t) addr){
                 return -EINVAL;
         }*/
         if (!PAGE_ALIGNED(off)){
-                dbg(DBG_PRINT, "(GRADING3D 1)\n");
+                grading_dbg("(GRADING3D 1)\n");
                 return -EINVAL;
         }
         if (!(flags & MAP_SHARED || flags & MAP_PRIVATE)) {
-                dbg(DBG_PRINT, "(GRADING3D 1)\n");
+                grading_dbg("(GRADING3D 1)\n");
                 return -EINVAL;
         }
         if ((flags & MAP_FIXED && NULL == addr)) {
-                dbg(DBG_PRINT, "(GRADING3D 1)\n");
+                grading_dbg("(GRADING3D 1)\n");
                 return -EINVAL;
         }
-        if (!(flags & MAP_ANON) && (fd < 0 || fd >= NFILES || NULL == curproc->p_files[fd])) {
-                dbg(DBG_PRINT, "(GRADING3D 1)\n");
+        if (!(flags & MAP_ANON) && NULL == fd_lookup(curproc, fd)) {
+                grading_dbg("(GRADING3D 1)\n");
                 return -EBADF;
         }
         /*if (!(prot == PROT_NONE || prot & PROT_READ || prot & PROT_WRITE || prot & PROT_EXEC)) {
                 return -EPERM;
         }*/
         if (!(flags & MAP_ANON)){
-                file = fget(fd);
+                file = fd_lookup(curproc, fd);
+                fref(file);
                 node = file->f_vnode;
                 if ((prot & PROT_WRITE) && (file->f_mode & 0x7) == FMODE_APPEND) {
                         fput(file);
-                        dbg(DBG_PRINT, "(GRADING3D 1)\n");
+                        grading_dbg("(GRADING3D 1)\n");
                         return -EACCES;
                 }
                 /*if ((flags & MAP_PRIVATE) && !(file->f_mode & FMODE_READ)) {
@@ -108,7 +111,7 @@ do_mmap(void *addr, size_t len, int prot, int flags,
                 if ((flags & MAP_SHARED) && (prot & PROT_WRITE) &&
                     !((file->f_mode & (FMODE_READ | FMODE_WRITE)) == (FMODE_READ | FMODE_WRITE))){
                         fput(file);
-                        dbg(DBG_PRINT, "(GRADING3D 1)\n");
+                        grading_dbg("(GRADING3D 1)\n");
                         return -EACCES;
                 }
                 /*if ((flags & MAP_SHARED) && (prot & PROT_WRITE) && 
@@ -118,25 +121,25 @@ do_mmap(void *addr, size_t len, int prot, int flags,
                         fput(file);
                         return -EACCES;
                 }*/
-                dbg(DBG_PRINT, "(GRADING3A)\n");
+                grading_dbg("(GRADING3A)\n");
         }
 
         int val = vmmap_map(curproc->p_vmmap, node, ADDR_TO_PN(addr),
                             (uint32_t) PAGE_ALIGN_UP(len) / PAGE_SIZE, prot,
                              flags, off, VMMAP_DIR_HILO, &vma);
 	KASSERT(NULL != curproc->p_pagedir);	
-	dbg(DBG_PRINT, "(GRADING3A 2.a)\n");
+	grading_dbg("(GRADING3A 2.a)\n");
         if (file) {
                 fput(file);
-		dbg(DBG_PRINT, "(GRADING3A)\n");
+		grading_dbg("(GRADING3A)\n");
         }
         if (val < 0){
-		dbg(DBG_PRINT, "(GRADING3D 2)\n");
+		grading_dbg("(GRADING3D 2)\n");
                 return val;
         }
         if (NULL != ret){
                 *ret = PN_TO_ADDR(vma->vma_start);
-		dbg(DBG_PRINT, "(GRADING3A)\n");
+		grading_dbg("(GRADING3A)\n");
         }
         pt_unmap_range(curproc->p_pagedir,
                (uintptr_t)PN_TO_ADDR(vma->vma_start),
@@ -145,7 +148,7 @@ do_mmap(void *addr, size_t len, int prot, int flags,
 
         tlb_flush_range((uintptr_t)addr,
                 (uint32_t) PAGE_ALIGN_UP(len) / PAGE_SIZE);
-	dbg(DBG_PRINT, "(GRADING3A)\n");
+	grading_dbg("(GRADING3A)\n");
         return 0;
 }
 
@@ -161,23 +164,23 @@ int
 do_munmap(void *addr, size_t len)
 {
         if (!PAGE_ALIGNED(addr)){
-		dbg(DBG_PRINT, "(GRADING3D 1)\n");
+		grading_dbg("(GRADING3D 1)\n");
                 return -EINVAL;
         }
         if ((uint32_t) addr < USER_MEM_LOW){
-		dbg(DBG_PRINT, "(GRADING3D 1)\n");
+		grading_dbg("(GRADING3D 1)\n");
                 return -EINVAL;
         }
         if (len == 0){
-		dbg(DBG_PRINT, "(GRADING3D 1)\n");
+		grading_dbg("(GRADING3D 1)\n");
                 return -EINVAL;
         }
         if (len > USER_MEM_HIGH){
-		dbg(DBG_PRINT, "(GRADING3D 1)\n");
+		grading_dbg("(GRADING3D 1)\n");
                 return -EINVAL;
         }
         if (len > USER_MEM_HIGH - (uint32_t) addr){
-		dbg(DBG_PRINT, "(GRADING3D 5)\n");
+		grading_dbg("(GRADING3D 5)\n");
                 return -EINVAL;
         }
         int val = vmmap_remove(curproc->p_vmmap, ADDR_TO_PN(addr),
@@ -188,7 +191,7 @@ do_munmap(void *addr, size_t len)
 
         tlb_flush_range((uintptr_t)addr, 
                         (uint32_t) PAGE_ALIGN_UP(len) / PAGE_SIZE);
-	dbg(DBG_PRINT, "(GRADING3D 1)\n");
+	grading_dbg("(GRADING3D 1)\n");
         return val;
 }
 
@@ -22,6 +22,7 @@
 #include "errno.h"
 
 #include "util/debug.h"
+#include "util/trace.h"
 
 #include "proc/proc.h"
 
@@ -34,6 +35,10 @@
 
 #include "vm/pagefault.h"
 #include "vm/vmmap.h"
+#include "vm/vmmap_lock.h"
+#include "vm/kdata.h"
+
+#include "api/kdata.h"
 
 /*
  * This gets called by _pt_fault_handler in mm/pagetable.c The
@@ -70,13 +75,29 @@ void
 handle_pagefault(uintptr_t vaddr, uint32_t cause)
 {
         uint32_t pn = ADDR_TO_PN(vaddr);
+        trace(pagefault, "pid %d vaddr 0x%x cause 0x%x\n", curproc->p_pid, vaddr, cause);
+        vmmap_rdlock(curproc->p_vmmap);
         vmarea_t *vma = vmmap_lookup(curproc->p_vmmap, pn);
+        if (NULL == vma && ADDR_TO_PN(KDATA_ADDR) == pn) {
+                /* images started by kernel_execve never went through
+                 * sys_execve, so map their kernel data page on first use */
+                vmmap_rdunlock(curproc->p_vmmap);
+                int err = kdata_map(curproc);
+                vmmap_rdlock(curproc->p_vmmap);
+                if (err < 0)
+                        dbg(DBG_VM, "pid %d: mapping kernel data page failed: %d\n",
+                            curproc->p_pid, err);
+                else
+                        vma = vmmap_lookup(curproc->p_vmmap, pn);
+        }
         if (NULL == vma) {
-		dbg(DBG_PRINT, "(GRADING3C 5)\n");
+                vmmap_rdunlock(curproc->p_vmmap);
+		grading_dbg("(GRADING3C 5)\n");
                 do_exit(EFAULT);
         }
         if ((cause & FAULT_WRITE) && !(vma->vma_prot & PROT_WRITE)) {
-		dbg(DBG_PRINT, "(GRADING3D 2)\n");
+                vmmap_rdunlock(curproc->p_vmmap);
+		grading_dbg("(GRADING3D 2)\n");
                 do_exit(EFAULT);
         }
         /*if ((cause & FAULT_EXEC) && !(vma->vma_prot & PROT_EXEC)) {
@@ -84,31 +105,34 @@ handle_pagefault(uintptr_t vaddr, uint32_t cause)
         }*/
         if (!(cause & FAULT_WRITE) && !(cause & FAULT_EXEC) && 
             !(vma->vma_prot & PROT_READ)) {
-		dbg(DBG_PRINT, "(GRADING3D 2)\n");
+                vmmap_rdunlock(curproc->p_vmmap);
+		grading_dbg("(GRADING3D 2)\n");
                 do_exit(EFAULT);
         }
         int forwrite = 0;
         if (cause & FAULT_WRITE) {
                 forwrite = 1;
-		dbg(DBG_PRINT, "(GRADING3A)\n");
+		grading_dbg("(GRADING3A)\n");
         }
         pframe_t *pf;
         int val = pframe_lookup(vma->vma_obj,
                   pn + vma->vma_off - vma->vma_start, forwrite, &pf);
         if (val < 0) {
-		dbg(DBG_PRINT, "(GRADING3D 2)\n");
+                vmmap_rdunlock(curproc->p_vmmap);
+		grading_dbg("(GRADING3D 2)\n");
                 do_exit(EFAULT);
         }
         KASSERT(pf); /* this page frame must be non-NULL */
         KASSERT(pf->pf_addr); /* this page frame's pf_addr must be non-NULL */
-        dbg(DBG_PRINT, "(GRADING3A 5.a)\n");
+        grading_dbg("(GRADING3A 5.a)\n");
 
         uint32_t flags = PD_PRESENT | PD_USER;
         if (forwrite) {
                 flags |= PD_WRITE;
-		dbg(DBG_PRINT, "(GRADING3A)\n");
+		grading_dbg("(GRADING3A)\n");
         }
         pt_map(curproc->p_pagedir, (uintptr_t)PAGE_ALIGN_DOWN(vaddr),
                pt_virt_to_phys((uintptr_t)(pf->pf_addr)), flags, flags);
-	dbg(DBG_PRINT, "(GRADING3A)\n");
+        vmmap_rdunlock(curproc->p_vmmap);
+	grading_dbg("(GRADING3A)\n");
 }
@@ -21,6 +21,7 @@
 
 #include "util/string.h"
 #include "util/debug.h"
+#include "util/trace.h"
 
 #include "mm/mmobj.h"
 #include "mm/pframe.h"
@@ -72,8 +73,8 @@ shadow_init()
 {
         shadow_allocator = slab_allocator_create("shadow", sizeof(mmobj_t));
         KASSERT(shadow_allocator); /* after initialization, shadow_allocator must not be NULL */
-        dbg(DBG_PRINT, "(GRADING3A 6.a)\n");
-	dbg(DBG_PRINT, "(GRADING3A)\n");
+        grading_dbg("(GRADING3A 6.a)\n");
+	grading_dbg("(GRADING3A)\n");
 }
 
 /*
@@ -90,9 +91,9 @@ shadow_create()
                 mmobj_init(mmo, &shadow_mmobj_ops);
                 mmo->mmo_refcount = 1;
                 shadow_count++;
-		dbg(DBG_PRINT, "(GRADING3A)\n");
+		grading_dbg("(GRADING3A)\n");
         }
-	dbg(DBG_PRINT, "(GRADING3A)\n");
+	grading_dbg("(GRADING3A)\n");
         return mmo;
 }
 
@@ -106,10 +107,10 @@ shadow_ref(mmobj_t *o)
 {
         KASSERT(o && (0 < o->mmo_refcount) && (&shadow_mmobj_ops == o->mmo_ops));
                                   /* the o function argument must be non-NULL, has a positive refcount, and is a shadow object */
-        dbg(DBG_PRINT, "(GRADING3A 6.b)\n");
+        grading_dbg("(GRADING3A 6.b)\n");
 
         o->mmo_refcount++;
-	dbg(DBG_PRINT, "(GRADING3A)\n");
+	grading_dbg("(GRADING3A)\n");
 }
 
 /*
@@ -125,7 +126,7 @@ shadow_put(mmobj_t *o)
 {
         KASSERT(o && (0 < o->mmo_refcount) && (&shadow_mmobj_ops == o->mmo_ops));
                                   /* the o function argument must be non-NULL, has a positive refcount, and is a shadow object */
-        dbg(DBG_PRINT, "(GRADING3A 6.c)\n");
+        grading_dbg("(GRADING3A 6.c)\n");
 
         if ((o->mmo_nrespages == (o->mmo_refcount - 1))) {
                 pframe_t *pf;
@@ -135,15 +136,15 @@ shadow_put(mmobj_t *o)
                         }*/
                         pframe_unpin(pf);
                         pframe_free(pf);
-			dbg(DBG_PRINT, "(GRADING3A)\n");
+			grading_dbg("(GRADING3A)\n");
                 } list_iterate_end();
 
                 KASSERT(0 == o->mmo_nrespages);
                 KASSERT(1 == o->mmo_refcount);
-		dbg(DBG_PRINT, "(GRADING3A)\n");
+		grading_dbg("(GRADING3A)\n");
         }
         if (0 < --o->mmo_refcount){
-		dbg(DBG_PRINT, "(GRADING3A)\n");
+		grading_dbg("(GRADING3A)\n");
                 return;
         }
         KASSERT(0 == o->mmo_refcount);
@@ -153,7 +154,7 @@ shadow_put(mmobj_t *o)
         o->mmo_un.mmo_bottom_obj->mmo_ops->put(o->mmo_un.mmo_bottom_obj);
         shadow_count--;
         slab_obj_free(shadow_allocator, o);
-	dbg(DBG_PRINT, "(GRADING3A)\n");
+	grading_dbg("(GRADING3A)\n");
 
 }
 
@@ -172,29 +173,29 @@ shadow_lookuppage(mmobj_t *o, uint32_t pagenum, int forwrite, pframe_t **pf)
         int val = 0;
         if(1 == forwrite){
                 val = pframe_get(o, pagenum, pf);
-		dbg(DBG_PRINT, "(GRADING3A)\n");
+		grading_dbg("(GRADING3A)\n");
                 return val;
         }
         pframe_t *pft = NULL;
         while(NULL == pft && NULL != o->mmo_shadowed){
                 pft = pframe_get_resident(o, pagenum);
                 o = o->mmo_shadowed;
-		dbg(DBG_PRINT, "(GRADING3A)\n");
+		grading_dbg("(GRADING3A)\n");
         }
         if(NULL == pft){
                 val = pframe_lookup(o, pagenum, forwrite, &pft);
                 if (val < 0) {
-			dbg(DBG_PRINT, "(GRADING3D 2)\n");
+			grading_dbg("(GRADING3D 2)\n");
                         return val;
                 }
-		dbg(DBG_PRINT, "(GRADING3A)\n");
+		grading_dbg("(GRADING3A)\n");
         }
         *pf = pft;
         KASSERT(NULL != (*pf)); /* on return, (*pf) must be non-NULL */
         KASSERT((pagenum == (*pf)->pf_pagenum) && (!pframe_is_busy(*pf)));
                                 /* on return, the page frame must have the right pagenum and it must not be in the "busy" state */
-        dbg(DBG_PRINT, "(GRADING3A 6.d)\n");
-	dbg(DBG_PRINT, "(GRADING3A)\n");
+        grading_dbg("(GRADING3A 6.d)\n");
+	grading_dbg("(GRADING3A)\n");
         return 0;
 }
 
@@ -214,7 +215,7 @@ shadow_fillpage(mmobj_t *o, pframe_t *pf)
 {
         KASSERT(pframe_is_busy(pf)); /* can only "fill" a page frame when the page frame is in the "busy" state */
         KASSERT(!pframe_is_pinned(pf)); /* must not fill a page frame that's already pinned */
-        dbg(DBG_PRINT, "(GRADING3A 6.e)\n");
+        grading_dbg("(GRADING3A 6.e)\n");
 
         o = o->mmo_shadowed;
         int val = 0;
@@ -222,19 +223,19 @@ shadow_fillpage(mmobj_t *o, pframe_t *pf)
 	while(NULL == pft && NULL != o->mmo_shadowed){
                 pft = pframe_get_resident(o, pf->pf_pagenum);
                 o = o->mmo_shadowed;
-		dbg(DBG_PRINT, "(GRADING3A)\n");
+		grading_dbg("(GRADING3A)\n");
         }
         if (NULL == pft){
                 val = pframe_lookup(o, pf->pf_pagenum, 0, &pft);
                 if(val < 0){
-			dbg(DBG_PRINT, "(GRADING3D 2)\n");
+			grading_dbg("(GRADING3D 2)\n");
                         return val;
                 }
-		dbg(DBG_PRINT, "(GRADING3A)\n");
+		grading_dbg("(GRADING3A)\n");
         }
         pframe_pin(pf);
         memcpy(pf->pf_addr, pft->pf_addr, PAGE_SIZE);
-	dbg(DBG_PRINT, "(GRADING3A)\n");
+	grading_dbg("(GRADING3A)\n");
         return val;
 }
 
@@ -243,7 +244,7 @@ shadow_fillpage(mmobj_t *o, pframe_t *pf)
 static int
 shadow_dirtypage(mmobj_t *o, pframe_t *pf)
 {
-	dbg(DBG_PRINT, "(GRADING3A)\n");
+	grading_dbg("(GRADING3A)\n");
         return 0;
 }
 
@@ -21,12 +21,15 @@
 #include "globals.h"
 
 #include "vm/vmmap.h"
+#include "vm/vmmap_lock.h"
 #include "vm/shadow.h"
 #include "vm/anon.h"
 
 #include "proc/proc.h"
+#include "proc/krwlock.h"
 
 #include "util/debug.h"
+#include "util/trace.h"
 #include "util/list.h"
 #include "util/string.h"
 #include "util/printf.h"
@@ -45,6 +48,17 @@
 static slab_allocator_t *vmmap_allocator;
 static slab_allocator_t *vmarea_allocator;
 
+/* Address space locks. Rather than growing every vmmap_t, maps share a
+ * small array of reader-writer locks picked by hashing the map's address.
+ * Two maps that hash to the same lock only contend when one of them is
+ * being modified. */
+#define VMMAP_NLOCKS 16
+#define vmmap_lock_of(map) \
+        (&vmmap_locks[(((uint32_t)(map)) >> 4) % VMMAP_NLOCKS])
+static krwlock_t vmmap_locks[VMMAP_NLOCKS];
+
+static int vmmap_remove_locked(vmmap_t *map, uint32_t lopage, uint32_t npages);
+
 void
 vmmap_init(void)
 {
@@ -52,6 +66,34 @@ vmmap_init(void)
         KASSERT(NULL != vmmap_allocator && "failed to create vmmap allocator!");
         vmarea_allocator = slab_allocator_create("vmarea", sizeof(vmarea_t));
         KASSERT(NULL != vmarea_allocator && "failed to create vmarea allocator!");
+
+        int i;
+        for (i = 0; i < VMMAP_NLOCKS; ++i)
+                krwlock_init(&vmmap_locks[i]);
+}
+
+void
+vmmap_rdlock(vmmap_t *map)
+{
+        krwlock_rdlock(vmmap_lock_of(map));
+}
+
+void
+vmmap_rdunlock(vmmap_t *map)
+{
+        krwlock_rdunlock(vmmap_lock_of(map));
+}
+
+void
+vmmap_wrlock(vmmap_t *map)
+{
+        krwlock_wrlock(vmmap_lock_of(map));
+}
+
+void
+vmmap_wrunlock(vmmap_t *map)
+{
+        krwlock_wrunlock(vmmap_lock_of(map));
 }
 
 vmarea_t *
@@ -130,9 +172,9 @@ vmmap_create(void)
         if (NULL != map) {
                 list_init(&map->vmm_list);
                 map->vmm_proc = NULL;
-		dbg(DBG_PRINT, "(GRADING3A)\n");
+		grading_dbg("(GRADING3A)\n");
         }
-	dbg(DBG_PRINT, "(GRADING3A)\n");
+	grading_dbg("(GRADING3A)\n");
         return map;
 }
 
@@ -142,25 +184,27 @@ void
 vmmap_destroy(vmmap_t *map)
 {
         KASSERT(NULL != map); /* function argument must not be NULL */
-        dbg(DBG_PRINT, "(GRADING3A 3.a)\n");
+        grading_dbg("(GRADING3A 3.a)\n");
 
         vmarea_t *vma;
+        vmmap_wrlock(map);
         list_iterate_begin(&map->vmm_list, vma, vmarea_t, vma_plink) {
                 list_remove(&vma->vma_plink);
                 if (list_link_is_linked(&vma->vma_olink)) {
                         list_remove(&vma->vma_olink);
-			dbg(DBG_PRINT, "(GRADING3A)\n");
+			grading_dbg("(GRADING3A)\n");
                 }
                 if (vma->vma_obj) {
                         vma->vma_obj->mmo_ops->put(vma->vma_obj);
-			dbg(DBG_PRINT, "(GRADING3A)\n");
+			grading_dbg("(GRADING3A)\n");
                 }
                 vmarea_free(vma);
-		dbg(DBG_PRINT, "(GRADING3A)\n");
+		grading_dbg("(GRADING3A)\n");
         } list_iterate_end();
         map->vmm_proc = NULL;
+        vmmap_wrunlock(map);
         slab_obj_free(vmmap_allocator, map);
-	dbg(DBG_PRINT, "(GRADING3A)\n");
+	grading_dbg("(GRADING3A)\n");
 }
 
 /* Add a vmarea to an address space. Assumes (i.e. asserts to some extent)
@@ -176,25 +220,25 @@ vmmap_insert(vmmap_t *map, vmarea_t *newvma)
         KASSERT(ADDR_TO_PN(USER_MEM_LOW) <= newvma->vma_start &&
                 ADDR_TO_PN(USER_MEM_HIGH) >= newvma->vma_end);
                 /* addresses in this memory segment must lie completely within the user space */
-        dbg(DBG_PRINT, "(GRADING3A 3.b)\n");
+        grading_dbg("(GRADING3A 3.b)\n");
 
         newvma->vma_vmmap = map;
         if (list_empty(&map->vmm_list)) {
                 list_insert_head(&map->vmm_list, &newvma->vma_plink);
-		dbg(DBG_PRINT, "(GRADING3A)\n");
+		grading_dbg("(GRADING3A)\n");
                 return;
         }
         vmarea_t *vma;
         list_iterate_begin(&map->vmm_list, vma, vmarea_t, vma_plink) {
                 if (vma->vma_start > newvma->vma_start) {
                         list_insert_before(&vma->vma_plink, &newvma->vma_plink);
-			dbg(DBG_PRINT, "(GRADING3A)\n");
+			grading_dbg("(GRADING3A)\n");
                         return;
                 }
-		dbg(DBG_PRINT, "(GRADING3A)\n");
+		grading_dbg("(GRADING3A)\n");
         } list_iterate_end();
         list_insert_tail(&map->vmm_list, &newvma->vma_plink);
-	dbg(DBG_PRINT, "(GRADING3A)\n");
+	grading_dbg("(GRADING3A)\n");
 }
 
 /* Find a contiguous range of free virtual pages of length npages in
@@ -224,35 +268,35 @@ vmmap_find_range(vmmap_t *map, uint32_t npages, int dir)
                 start = ADDR_TO_PN(USER_MEM_HIGH);
                 list_iterate_reverse(&map->vmm_list, vma, vmarea_t, vma_plink) {
                         if (start - vma->vma_end >= npages) {
-				dbg(DBG_PRINT, "(GRADING3A)\n");
+				grading_dbg("(GRADING3A)\n");
                                 return start - npages;
                         }
                         start = vma->vma_start;
-			dbg(DBG_PRINT, "(GRADING3D 1)\n");
+			grading_dbg("(GRADING3D 1)\n");
                 } list_iterate_end();
                 if (start - ADDR_TO_PN(USER_MEM_LOW) >= npages) {
-			dbg(DBG_PRINT, "(GRADING3D 2)\n");
+			grading_dbg("(GRADING3D 2)\n");
                         return start - npages;
                 }
-		dbg(DBG_PRINT, "(GRADING3D 2)\n");
+		grading_dbg("(GRADING3D 2)\n");
         }
-	dbg(DBG_PRINT, "(GRADING3D 2)\n");*/
+	grading_dbg("(GRADING3D 2)\n");*/
 	uint32_t start;
         vmarea_t *vma;
 	start = ADDR_TO_PN(USER_MEM_HIGH);
         list_iterate_reverse(&map->vmm_list, vma, vmarea_t, vma_plink) {
                 if (start - vma->vma_end >= npages) {
-			dbg(DBG_PRINT, "(GRADING3A)\n");
+			grading_dbg("(GRADING3A)\n");
                         return start - npages;
                 }
                 start = vma->vma_start;
-		dbg(DBG_PRINT, "(GRADING3D 1)\n");
+		grading_dbg("(GRADING3D 1)\n");
         } list_iterate_end();
         if (start - ADDR_TO_PN(USER_MEM_LOW) >= npages) {
-		dbg(DBG_PRINT, "(GRADING3D 2)\n");
+		grading_dbg("(GRADING3D 2)\n");
                 return start - npages;
         }
-	dbg(DBG_PRINT, "(GRADING3D 2)\n");
+	grading_dbg("(GRADING3D 2)\n");
 
 
         return -1;
@@ -265,17 +309,18 @@ vmarea_t *
 vmmap_lookup(vmmap_t *map, uint32_t vfn)
 {
         KASSERT(NULL != map); /* the first function argument must not be NULL */
-        dbg(DBG_PRINT, "(GRADING3A 3.c)\n");
+        grading_dbg("(GRADING3A 3.c)\n");
+        trace(vmmap, "map 0x%p vfn 0x%x\n", map, vfn);
 
         vmarea_t *vma;
         list_iterate_begin(&map->vmm_list, vma, vmarea_t, vma_plink) {
                 if (vma->vma_start <= vfn && vfn < vma->vma_end) {
-			dbg(DBG_PRINT, "(GRADING3A)\n");
+			grading_dbg("(GRADING3A)\n");
                         return vma;
                 }
-		dbg(DBG_PRINT, "(GRADING3A)\n");
+		grading_dbg("(GRADING3A)\n");
         } list_iterate_end();
-	dbg(DBG_PRINT, "(GRADING3C 5)\n");
+	grading_dbg("(GRADING3C 5)\n");
         return NULL;
 }
 
@@ -292,6 +337,7 @@ vmmap_clone(vmmap_t *map)
         }*/
         newmap->vmm_proc = map->vmm_proc;
         vmarea_t *vma;
+        vmmap_rdlock(map);
         list_iterate_begin(&map->vmm_list, vma, vmarea_t, vma_plink) {
                 vmarea_t *newvma = vmarea_alloc();
                 /*if (NULL == newvma) {
@@ -308,9 +354,10 @@ vmmap_clone(vmmap_t *map)
                 list_link_init(&newvma->vma_plink);
                 list_link_init(&newvma->vma_olink);
                 list_insert_tail(&newmap->vmm_list, &newvma->vma_plink);
-		dbg(DBG_PRINT, "(GRADING3A)\n");
+		grading_dbg("(GRADING3A)\n");
         } list_iterate_end();
-	dbg(DBG_PRINT, "(GRADING3A)\n");
+        vmmap_rdunlock(map);
+	grading_dbg("(GRADING3A)\n");
         return newmap;
 }
 
@@ -350,22 +397,24 @@ vmmap_map(vmmap_t *map, vnode_t *file, uint32_t lopage, uint32_t npages,
         KASSERT((0 == lopage) || (ADDR_TO_PN(USER_MEM_HIGH) >= (lopage + npages)));
                                     /* if lopage is not zero, the specified page range must lie completely within the user space */
         KASSERT(PAGE_ALIGNED(off)); /* the off argument must be page aligned */
-        dbg(DBG_PRINT, "(GRADING3A 3.d)\n");
+        grading_dbg("(GRADING3A 3.d)\n");
 
+        vmmap_wrlock(map);
         if (0 == lopage) {
                 int val = vmmap_find_range(map, npages, dir);
                 if (-1 == val) {
-			dbg(DBG_PRINT, "(GRADING3D 2)\n");
+                        vmmap_wrunlock(map);
+			grading_dbg("(GRADING3D 2)\n");
                         return -1; // ??? return value
                 }
                 lopage = (uint32_t)val;
-		dbg(DBG_PRINT, "(GRADING3A)\n");
+		grading_dbg("(GRADING3A)\n");
         } else if (!vmmap_is_range_empty(map, lopage, npages)) {
-                int val = vmmap_remove(map, lopage, npages);
+                int val = vmmap_remove_locked(map, lopage, npages);
                 /*if (val < 0) {
                         return val;
                 }*/
-		dbg(DBG_PRINT, "(GRADING3A)\n");
+		grading_dbg("(GRADING3A)\n");
         }
 
         vmarea_t *vma = vmarea_alloc();
@@ -384,14 +433,14 @@ vmmap_map(vmmap_t *map, vnode_t *file, uint32_t lopage, uint32_t npages,
                         vmarea_free(vma);
                         return -1; // ??? return value
                 }*/
-		dbg(DBG_PRINT, "(GRADING3A)\n");
+		grading_dbg("(GRADING3A)\n");
         } else {
                 int val = file->vn_ops->mmap(file, vma, &mmo);
                 /*if (val < 0) {
                         vmarea_free(vma);
                         return val;
                 }*/
-		dbg(DBG_PRINT, "(GRADING3A)\n");
+		grading_dbg("(GRADING3A)\n");
         }
         vma->vma_obj = mmo;
 
@@ -408,14 +457,15 @@ vmmap_map(vmmap_t *map, vnode_t *file, uint32_t lopage, uint32_t npages,
                 shadow->mmo_un.mmo_bottom_obj = bot;
                 bot->mmo_ops->ref(bot);
                 vma->vma_obj = shadow;
-		dbg(DBG_PRINT, "(GRADING3A)\n");
+		grading_dbg("(GRADING3A)\n");
         }
         if (NULL != new) {
                 *new = vma;
-		dbg(DBG_PRINT, "(GRADING3A)\n");
+		grading_dbg("(GRADING3A)\n");
         }
         vmmap_insert(map, vma);
-	dbg(DBG_PRINT, "(GRADING3A)\n");
+        vmmap_wrunlock(map);
+	grading_dbg("(GRADING3A)\n");
         return 0;
 }
 
@@ -450,15 +500,25 @@ vmmap_map(vmmap_t *map, vnode_t *file, uint32_t lopage, uint32_t npages,
  */
 int
 vmmap_remove(vmmap_t *map, uint32_t lopage, uint32_t npages)
+{
+        vmmap_wrlock(map);
+        int val = vmmap_remove_locked(map, lopage, npages);
+        vmmap_wrunlock(map);
+        return val;
+}
+
+/* vmmap_remove with the map already locked exclusive (by vmmap_map). */
+static int
+vmmap_remove_locked(vmmap_t *map, uint32_t lopage, uint32_t npages)
 {
         uint32_t hipage = lopage + npages;
         vmarea_t *vma;
         list_iterate_begin(&map->vmm_list, vma, vmarea_t, vma_plink) {
                 if (hipage <= vma->vma_start) {
-			dbg(DBG_PRINT, "(GRADING3D 1)\n");
+			grading_dbg("(GRADING3D 1)\n");
                         return 0;
                 } else if (vma->vma_end <= lopage) {
-			dbg(DBG_PRINT, "(GRADING3A)\n");
+			grading_dbg("(GRADING3A)\n");
                         continue;
                 }
                 if (vma->vma_start < lopage && hipage < vma->vma_end) {
@@ -481,32 +541,32 @@ vmmap_remove(vmmap_t *map, uint32_t lopage, uint32_t npages)
                         vma->vma_end = lopage;
 
                         vmmap_insert(map, newvma);
-			dbg(DBG_PRINT, "(GRADING3D 2)\n");
+			grading_dbg("(GRADING3D 2)\n");
                         return 0;
                         
                 } else if (vma->vma_start < lopage && lopage < vma->vma_end) {
                         vma->vma_end = lopage;
-			dbg(DBG_PRINT, "(GRADING3D 1)\n");
+			grading_dbg("(GRADING3D 1)\n");
                 } else if (vma->vma_start < hipage && hipage < vma->vma_end) {
                         vma->vma_off = vma->vma_off + hipage - vma->vma_start;
                         vma->vma_start = hipage;
-			dbg(DBG_PRINT, "(GRADING3D 2)\n");
+			grading_dbg("(GRADING3D 2)\n");
                         return 0;
                 } else {
                         list_remove(&vma->vma_plink);
                         if (list_link_is_linked(&vma->vma_olink)) {
                                 list_remove(&vma->vma_olink);
-				dbg(DBG_PRINT, "(GRADING3A)\n");
+				grading_dbg("(GRADING3A)\n");
                         }
                         if (vma->vma_obj) {
                                 vma->vma_obj->mmo_ops->put(vma->vma_obj);
-				dbg(DBG_PRINT, "(GRADING3A)\n");
+				grading_dbg("(GRADING3A)\n");
                         }
                         vmarea_free(vma);
-			dbg(DBG_PRINT, "(GRADING3A)\n");
+			grading_dbg("(GRADING3A)\n");
                 }
         } list_iterate_end();
-	dbg(DBG_PRINT, "(GRADING3A)\n");
+	grading_dbg("(GRADING3A)\n");
         return 0;
 }
 
@@ -525,18 +585,18 @@ vmmap_is_range_empty(vmmap_t *map, uint32_t startvfn, uint32_t npages)
 
         KASSERT((startvfn < endvfn) && (ADDR_TO_PN(USER_MEM_LOW) <= startvfn) && (ADDR_TO_PN(USER_MEM_HIGH) >= endvfn));
                 /* the specified page range must not be empty and lie completely within the user space */
-        dbg(DBG_PRINT, "(GRADING3A 3.e)\n");
+        grading_dbg("(GRADING3A 3.e)\n");
 
         list_iterate_begin(&map->vmm_list, vma, vmarea_t, vma_plink) {
                 if ((vma->vma_start <= startvfn && startvfn < vma->vma_end) ||
                     (vma->vma_start < endvfn && endvfn <= vma->vma_end) || 
                     (startvfn < vma->vma_start && vma->vma_end < endvfn)) {
-			dbg(DBG_PRINT, "(GRADING3A)\n");
+			grading_dbg("(GRADING3A)\n");
                         return 0;
                 }
-		dbg(DBG_PRINT, "(GRADING3A)\n");
+		grading_dbg("(GRADING3A)\n");
         } list_iterate_end();
-	dbg(DBG_PRINT, "(GRADING3A)\n");
+	grading_dbg("(GRADING3A)\n");
         return 1;
 }
 
@@ -553,6 +613,7 @@ vmmap_read(vmmap_t *map, const void *vaddr, void *buf, size_t count)
 {
         uint32_t addr = (uint32_t)vaddr;
         char *buffer = (char *)buf;
+        vmmap_rdlock(map);
         while (count > 0) {
                 uint32_t pn = ADDR_TO_PN(addr);
                 vmarea_t *vma = vmmap_lookup(map, pn);
@@ -573,9 +634,10 @@ vmmap_read(vmmap_t *map, const void *vaddr, void *buf, size_t count)
                 addr += len;
                 count -= len;
                 buffer += len;
-		dbg(DBG_PRINT, "(GRADING3A)\n");
+		grading_dbg("(GRADING3A)\n");
         }
-	dbg(DBG_PRINT, "(GRADING3A)\n");
+        vmmap_rdunlock(map);
+	grading_dbg("(GRADING3A)\n");
         return 0;
 }
 
@@ -592,6 +654,7 @@ vmmap_write(vmmap_t *map, void *vaddr, const void *buf, size_t count)
 {
         uint32_t addr = (uint32_t)vaddr;
         char* buffer = (char *)buf;
+        vmmap_rdlock(map);
         while (count > 0) {
                 uint32_t pn = ADDR_TO_PN(addr);
                 vmarea_t *vma = vmmap_lookup(map, pn);
@@ -613,8 +676,9 @@ vmmap_write(vmmap_t *map, void *vaddr, const void *buf, size_t count)
                 addr += len;
                 count -= len;
                 buffer += len;
-		dbg(DBG_PRINT, "(GRADING3A)\n");
+		grading_dbg("(GRADING3A)\n");
         }
-	dbg(DBG_PRINT, "(GRADING3A)\n");
+        vmmap_rdunlock(map);
+	grading_dbg("(GRADING3A)\n");
         return 0;
 }